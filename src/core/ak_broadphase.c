@@ -0,0 +1,1146 @@
+#include "ak_broadphase.h"
+
+static int Overlaps(const ak_aabb_t *a, const ak_aabb_t *b) {
+  return a->min.x <= b->max.x && b->min.x <= a->max.x &&
+         a->min.y <= b->max.y && b->min.y <= a->max.y;
+}
+
+// Visitor used by the tree walks. Return 0 to stop.
+typedef int (*ak_leaf_fn)(ak_world_t *world, int body, void *ctx);
+
+typedef struct {
+  ak_packet_test_fn test;
+  ak_packet_fn fn;
+  void *ctx;
+  uint32_t live; // Queries not yet finished
+} ak_packet_t;
+
+// Tight bounds test before handing a candidate to the queries. Returns 0 once
+// none is left.
+static int ReportCandidate(ak_world_t *world, int body, uint32_t mask,
+                           ak_packet_t *p) {
+  mask &= p->live;
+  if (mask) {
+    ak_aabb_t b = ak_body_aabb(world, body);
+    mask = p->test(&b, mask, p->ctx);
+  }
+  if (mask)
+    p->live &= p->fn(world, body, mask, p->ctx) | ~mask;
+  return p->live != 0;
+}
+
+typedef struct {
+  ak_pair_fn fn;
+  int body;
+  ak_aabb_t box; // Bounds of body
+} ak_pair_query_t;
+
+// Two sleeping bodies cannot push each other, so their pair is dropped here
+static void EmitPair(ak_world_t *world, ak_pair_fn fn, int a, int b) {
+  if (ak_body_asleep(world, a) && ak_body_asleep(world, b))
+    return;
+  if (a < b)
+    fn(world, a, b);
+  else
+    fn(world, b, a);
+}
+
+// Collision filters are tested before the bounds, being cheaper. Each pair
+// or node they reject is counted.
+static int Collides(ak_world_t *world, int a, int b) {
+  if (ak_bodies_collide(&world->bodies[a], &world->bodies[b]))
+    return 1;
+  world->stats.pairs_culled++;
+  return 0;
+}
+
+// Whether a node whose bodies' filters have these unions can hold a body
+// colliding with body
+static int NodeCollides(ak_world_t *world, const ak_body_t *body,
+                        uint16_t category, uint16_t mask) {
+  if ((category & body->mask) && (mask & body->category))
+    return 1;
+  world->stats.nodes_culled++;
+  return 0;
+}
+
+// --- Baked Static Set ---
+
+static ak_fixed_t SplitKey(const ak_world_t *world, int body, int axis) {
+  return axis ? AK_BODY_POS_Y(world, body) : AK_BODY_POS_X(world, body);
+}
+
+// Partially sort idx[] so that idx[k] holds the median along axis
+static void SelectMedian(const ak_world_t *world, int16_t *idx, int count,
+                         int k, int axis) {
+  int lo = 0;
+  int hi = count - 1;
+  while (lo < hi) {
+    ak_fixed_t pivot = SplitKey(world, idx[(lo + hi) / 2], axis);
+    int i = lo;
+    int j = hi;
+    while (i <= j) {
+      while (SplitKey(world, idx[i], axis) < pivot)
+        i++;
+      while (SplitKey(world, idx[j], axis) > pivot)
+        j--;
+      if (i <= j) {
+        int16_t tmp = idx[i];
+        idx[i] = idx[j];
+        idx[j] = tmp;
+        i++;
+        j--;
+      }
+    }
+    if (k <= j)
+      hi = j;
+    else if (k >= i)
+      lo = i;
+    else
+      break;
+  }
+}
+
+static int BuildStatic(ak_world_t *world, int first, int count) {
+  ak_static_set_t *st = &world->statics;
+  int node = st->node_count++;
+  ak_aabb_t box = ak_body_aabb(world, st->order[first]);
+  uint16_t category = 0;
+  uint16_t mask = 0;
+
+  for (int i = 0; i < count; i++) {
+    const ak_body_t *body = &world->bodies[st->order[first + i]];
+    category |= body->category;
+    mask |= body->mask;
+    if (i == 0)
+      continue;
+    ak_aabb_t b = ak_body_aabb(world, body->id);
+    box.min.x = AK_FIXED_MIN(box.min.x, b.min.x);
+    box.min.y = AK_FIXED_MIN(box.min.y, b.min.y);
+    box.max.x = AK_FIXED_MAX(box.max.x, b.max.x);
+    box.max.y = AK_FIXED_MAX(box.max.y, b.max.y);
+  }
+  st->nodes[node].box = box;
+  st->nodes[node].category = category;
+  st->nodes[node].mask = mask;
+
+  if (count <= AK_STATIC_LEAF_SIZE) {
+    st->nodes[node].first = (int16_t)first;
+    st->nodes[node].count = (int16_t)count;
+    return node;
+  }
+
+  // Median split along the longer axis
+  int axis = (box.max.y - box.min.y) > (box.max.x - box.min.x);
+  int half = count / 2;
+  SelectMedian(world, &st->order[first], count, half, axis);
+
+  st->nodes[node].count = 0;
+  BuildStatic(world, first, half); // Left child lands at node + 1
+  int right = BuildStatic(world, first + half, count - half);
+  st->nodes[node].first = (int16_t)right;
+  return node;
+}
+
+// The split leaves order[] shuffled, and removals leave it out of index
+// order, so each bake starts again from index order: the tree then depends
+// only on which static bodies there are.
+void ak_broadphase_bake_static(ak_world_t *world) {
+  ak_static_set_t *st = &world->statics;
+  int n = 0;
+  for (int i = 0; i < world->body_count; i++) {
+    if (world->bodies[i].is_static)
+      st->order[n++] = (int16_t)i;
+  }
+  st->node_count = 0;
+  st->dirty = 0;
+  if (st->count > 0)
+    BuildStatic(world, 0, st->count);
+  for (int k = 0; k < st->count; k++)
+    world->bodies[st->order[k]].list_index = k;
+}
+
+// Subtrees holding nothing the filter of body accepts are skipped
+static void StaticQuery(ak_world_t *world, const ak_aabb_t *box,
+                        const ak_body_t *body, ak_leaf_fn fn, void *ctx) {
+  ak_static_set_t *st = &world->statics;
+  int16_t stack[AK_STATIC_STACK_SIZE];
+  int top = 0;
+
+  if (st->node_count == 0)
+    return;
+  stack[top++] = 0;
+
+  while (top > 0) {
+    int n = stack[--top];
+    for (;;) {
+      ak_static_node_t *node = &st->nodes[n];
+      if (!Overlaps(&node->box, box) ||
+          !NodeCollides(world, body, node->category, node->mask))
+        break;
+      if (node->count > 0) {
+        for (int i = 0; i < node->count; i++) {
+          if (!fn(world, st->order[node->first + i], ctx))
+            return;
+        }
+        break;
+      }
+      if (top < AK_STATIC_STACK_SIZE)
+        stack[top++] = node->first;
+      n++;
+    }
+  }
+}
+
+// Same walk as StaticQuery, carrying the mask of queries still inside each
+// node. Returns 0 once no query is left.
+static int StaticPacket(ak_world_t *world, ak_packet_t *p) {
+  ak_static_set_t *st = &world->statics;
+  int16_t stack[AK_STATIC_STACK_SIZE];
+  uint32_t masks[AK_STATIC_STACK_SIZE];
+  int top = 0;
+
+  if (st->node_count == 0)
+    return 1;
+  stack[top] = 0;
+  masks[top++] = p->live;
+
+  while (top > 0) {
+    int n = stack[--top];
+    uint32_t mask = masks[top];
+    for (;;) {
+      ak_static_node_t *node = &st->nodes[n];
+      mask &= p->live;
+      if (mask)
+        mask = p->test(&node->box, mask, p->ctx);
+      if (!mask)
+        break;
+      if (node->count > 0) {
+        for (int i = 0; i < node->count; i++) {
+          if (!ReportCandidate(world, st->order[node->first + i], mask, p))
+            return 0;
+        }
+        break;
+      }
+      if (top < AK_STATIC_STACK_SIZE) {
+        stack[top] = node->first;
+        masks[top++] = mask;
+      }
+      n++;
+    }
+  }
+  return 1;
+}
+
+// Leaves hold several bodies, so test each one before reporting it
+static int ReportStaticPair(ak_world_t *world, int other, void *ctx) {
+  ak_pair_query_t *q = (ak_pair_query_t *)ctx;
+  if (!Collides(world, q->body, other))
+    return 1;
+  ak_aabb_t b = ak_body_aabb(world, other);
+  if (Overlaps(&b, &q->box))
+    EmitPair(world, q->fn, q->body, other);
+  return 1;
+}
+
+static void StaticPairs(ak_world_t *world, ak_pair_fn fn) {
+  ak_pair_query_t q;
+  q.fn = fn;
+  for (int i = 0; i < world->dynamic_count; i++) {
+    q.body = world->dynamic_bodies[i];
+    if (ak_body_asleep(world, q.body))
+      continue;
+    q.box = ak_body_aabb(world, q.body);
+    StaticQuery(world, &q.box, &world->bodies[q.body], ReportStaticPair, &q);
+  }
+}
+
+static void DynamicPairs(ak_world_t *world, ak_pair_fn fn);
+static void DynamicPacket(ak_world_t *world, ak_packet_t *p);
+
+void ak_broadphase_find_pairs(ak_world_t *world, ak_pair_fn fn) {
+  StaticPairs(world, fn);
+  DynamicPairs(world, fn);
+}
+
+void ak_broadphase_query_packet(ak_world_t *world, uint32_t mask,
+                                ak_packet_test_fn test, ak_packet_fn fn,
+                                void *ctx) {
+  ak_packet_t p = {test, fn, ctx, mask};
+  if (StaticPacket(world, &p))
+    DynamicPacket(world, &p);
+}
+
+// The grid and the sweep only know where bodies were at the last step, so
+// queries scan the dynamic bodies instead
+#if AK_BROADPHASE != AK_BROADPHASE_TREE
+static void DynamicPacket(ak_world_t *world, ak_packet_t *p) {
+  for (int i = 0; i < world->dynamic_count; i++) {
+    if (!ReportCandidate(world, world->dynamic_bodies[i], p->live, p))
+      break;
+  }
+}
+#endif
+
+#if AK_BROADPHASE == AK_BROADPHASE_NONE
+
+void ak_broadphase_init(ak_world_t *world) { (void)world; }
+
+void ak_broadphase_add(ak_world_t *world, int body) {
+  (void)world;
+  (void)body;
+}
+
+void ak_broadphase_remove(ak_world_t *world, int body) {
+  (void)world;
+  (void)body;
+}
+
+void ak_broadphase_move(ak_world_t *world, int from, int to) {
+  (void)world;
+  (void)from;
+  (void)to;
+}
+
+void ak_broadphase_refilter(ak_world_t *world, int body) {
+  (void)world;
+  (void)body;
+}
+
+// Every pair is tested, but only overlapping bounds reach the narrow phase.
+static void DynamicPairs(ak_world_t *world, ak_pair_fn fn) {
+  for (int i = 0; i < world->dynamic_count; i++) {
+    int a = world->dynamic_bodies[i];
+    ak_aabb_t box = ak_body_aabb(world, a);
+    for (int j = i + 1; j < world->dynamic_count; j++) {
+      int b = world->dynamic_bodies[j];
+      if (!Collides(world, a, b))
+        continue;
+      ak_aabb_t other = ak_body_aabb(world, b);
+      if (Overlaps(&box, &other))
+        EmitPair(world, fn, a, b);
+    }
+  }
+}
+
+#elif AK_BROADPHASE == AK_BROADPHASE_GRID
+
+// --- Uniform Grid ---
+// Rebuilt from scratch every step: bodies are binned into every cell their
+// bounds touch, and a pair sharing several cells is only reported from the
+// first cell both of them cover.
+
+static int CellCoord(ak_fixed_t v, int shift, int limit) {
+  int c = (int)(v >> (AK_FIXED_SHIFT + shift));
+  if (c < 0)
+    return 0;
+  if (c >= limit)
+    return limit - 1;
+  return c;
+}
+
+void ak_broadphase_init(ak_world_t *world) {
+  ak_grid_t *g = &world->grid;
+  int width_px = AK_FIXED_TO_INT(world->width + AK_FIXED_ONE - 1);
+  int height_px = AK_FIXED_TO_INT(world->height + AK_FIXED_ONE - 1);
+
+  g->cell_shift = AK_GRID_CELL_SHIFT;
+  for (;;) {
+    int size = 1 << g->cell_shift;
+    g->cols = (width_px + size - 1) >> g->cell_shift;
+    g->rows = (height_px + size - 1) >> g->cell_shift;
+    if (g->cols < 1)
+      g->cols = 1;
+    if (g->rows < 1)
+      g->rows = 1;
+    if ((int32_t)g->cols * g->rows <= AK_GRID_MAX_CELLS)
+      break;
+    g->cell_shift++;
+  }
+  g->large_count = 0;
+}
+
+void ak_broadphase_add(ak_world_t *world, int body) {
+  (void)world;
+  (void)body;
+}
+
+void ak_broadphase_remove(ak_world_t *world, int body) {
+  (void)world;
+  (void)body;
+}
+
+void ak_broadphase_move(ak_world_t *world, int from, int to) {
+  (void)world;
+  (void)from;
+  (void)to;
+}
+
+void ak_broadphase_refilter(ak_world_t *world, int body) {
+  (void)world;
+  (void)body;
+}
+
+static void DynamicPairs(ak_world_t *world, ak_pair_fn fn) {
+  ak_grid_t *g = &world->grid;
+  int cell_count = g->cols * g->rows;
+  int entry_count = 0;
+
+  for (int c = 0; c < cell_count; c++)
+    g->cell_head[c] = -1;
+  g->large_count = 0;
+
+  // Bin bodies
+  for (int d = 0; d < world->dynamic_count; d++) {
+    int i = world->dynamic_bodies[d];
+    ak_aabb_t box = ak_body_aabb(world, i);
+
+    int c0 = CellCoord(box.min.x, g->cell_shift, g->cols);
+    int c1 = CellCoord(box.max.x, g->cell_shift, g->cols);
+    int r0 = CellCoord(box.min.y, g->cell_shift, g->rows);
+    int r1 = CellCoord(box.max.y, g->cell_shift, g->rows);
+    int span = (c1 - c0 + 1) * (r1 - r0 + 1);
+
+    if (span > AK_GRID_LARGE_CELLS ||
+        entry_count + span > g->entry_capacity) {
+      g->min_col[i] = -1; // Marks a large body
+      g->large[g->large_count++] = (int16_t)i;
+      continue;
+    }
+
+    g->min_col[i] = (int16_t)c0;
+    g->min_row[i] = (int16_t)r0;
+    for (int r = r0; r <= r1; r++) {
+      for (int c = c0; c <= c1; c++) {
+        int cell = r * g->cols + c;
+        g->entry_body[entry_count] = (int16_t)i;
+        g->entry_next[entry_count] = g->cell_head[cell];
+        g->cell_head[cell] = (int16_t)entry_count;
+        entry_count++;
+      }
+    }
+  }
+
+  // Pairs sharing a cell
+  for (int r = 0; r < g->rows; r++) {
+    for (int c = 0; c < g->cols; c++) {
+      for (int e1 = g->cell_head[r * g->cols + c]; e1 >= 0;
+           e1 = g->entry_next[e1]) {
+        int a = g->entry_body[e1];
+        for (int e2 = g->entry_next[e1]; e2 >= 0; e2 = g->entry_next[e2]) {
+          int b = g->entry_body[e2];
+
+          // Only the first shared cell reports the pair
+          int first_c = AK_FIXED_MAX(g->min_col[a], g->min_col[b]);
+          int first_r = AK_FIXED_MAX(g->min_row[a], g->min_row[b]);
+          if (first_c != c || first_r != r || !Collides(world, a, b))
+            continue;
+
+          ak_aabb_t box_a = ak_body_aabb(world, a);
+          ak_aabb_t box_b = ak_body_aabb(world, b);
+          if (Overlaps(&box_a, &box_b))
+            EmitPair(world, fn, a, b);
+        }
+      }
+    }
+  }
+
+  // Large bodies are tested against everything
+  for (int k = 0; k < g->large_count; k++) {
+    int a = g->large[k];
+    ak_aabb_t box_a = ak_body_aabb(world, a);
+    for (int d = 0; d < world->dynamic_count; d++) {
+      int i = world->dynamic_bodies[d];
+      if (i == a)
+        continue;
+      // Large-vs-large is reported once, from the lower index
+      if ((g->min_col[i] < 0 && i < a) || !Collides(world, a, i))
+        continue;
+      ak_aabb_t box_i = ak_body_aabb(world, i);
+      if (Overlaps(&box_a, &box_i))
+        EmitPair(world, fn, a, i);
+    }
+  }
+}
+
+#elif AK_BROADPHASE == AK_BROADPHASE_SAP
+
+// --- Sort and Sweep ---
+// Bodies are projected onto the x axis. Endpoints are kept sorted across
+// steps, so with 1/60s steps the insertion sort is close to linear. The sweep
+// then only compares bodies whose x intervals overlap, and checks y before
+// reporting. A very wide body such as the ground stays open for the whole
+// sweep, which costs one y test per body rather than any extra sorting.
+
+// Min endpoints sort before max endpoints at the same x so that touching
+// intervals are still reported, matching the narrow phase's inclusive tests.
+static int EndpointLess(const ak_sap_endpoint_t *a,
+                        const ak_sap_endpoint_t *b) {
+  if (a->value != b->value)
+    return a->value < b->value;
+  return !a->is_max && b->is_max;
+}
+
+void ak_broadphase_init(ak_world_t *world) {
+  world->sap.endpoint_count = 0;
+  world->sap.sorted_count = 0;
+  world->sap.moved = 0;
+}
+
+void ak_broadphase_add(ak_world_t *world, int body) {
+  ak_sap_t *sap = &world->sap;
+  ak_sap_endpoint_t *e = &sap->endpoints[sap->endpoint_count];
+
+  // Values are filled in by the next update; the sort places them.
+  e[0].handle = world->bodies[body].handle;
+  e[0].body = (int16_t)body;
+  e[0].is_max = 0;
+  e[1].handle = world->bodies[body].handle;
+  e[1].body = (int16_t)body;
+  e[1].is_max = 1;
+  sap->endpoint_count += 2;
+}
+
+// Finding a body's endpoints would take a search, so the next update drops
+// and renumbers them through their handles instead
+void ak_broadphase_remove(ak_world_t *world, int body) {
+  (void)body;
+  world->sap.moved = 1;
+}
+
+void ak_broadphase_move(ak_world_t *world, int from, int to) {
+  (void)from;
+  (void)to;
+  world->sap.moved = 1;
+}
+
+void ak_broadphase_refilter(ak_world_t *world, int body) {
+  (void)world;
+  (void)body;
+}
+
+// Heap order for the new endpoints. Ties keep the order the bodies were
+// added in, held in handle while sorting, so the batch lands exactly where
+// inserting the endpoints one by one would have put it.
+static int NewEndpointLess(const ak_sap_endpoint_t *a,
+                           const ak_sap_endpoint_t *b) {
+  if (a->value != b->value || a->is_max != b->is_max)
+    return EndpointLess(a, b);
+  return a->handle < b->handle;
+}
+
+static void SiftDown(ak_sap_endpoint_t *e, int root, int count) {
+  for (;;) {
+    int child = 2 * root + 1;
+    if (child >= count)
+      return;
+    if (child + 1 < count && NewEndpointLess(&e[child], &e[child + 1]))
+      child++;
+    if (!NewEndpointLess(&e[root], &e[child]))
+      return;
+    ak_sap_endpoint_t tmp = e[root];
+    e[root] = e[child];
+    e[child] = tmp;
+    root = child;
+  }
+}
+
+static void SortNewEndpoints(ak_sap_endpoint_t *e, int count) {
+  for (int i = 0; i < count; i++)
+    e[i].handle = (ak_body_handle_t)i;
+  for (int i = count / 2 - 1; i >= 0; i--)
+    SiftDown(e, i, count);
+  for (int n = count - 1; n > 0; n--) {
+    ak_sap_endpoint_t tmp = e[0];
+    e[0] = e[n];
+    e[n] = tmp;
+    SiftDown(e, 0, n);
+  }
+}
+
+// Merge the sorted new endpoints e[sorted, count) into e[0, sorted), a chunk
+// at a time. Each chunk waits in the narrow phase's sort buffer, which is
+// idle until the sweep reports pairs, as two words: value, then body and
+// is_max.
+static void MergeNewEndpoints(ak_world_t *world, int sorted, int count) {
+  ak_sap_endpoint_t *e = world->sap.endpoints;
+  uint32_t *stage = world->pair_scratch;
+  int room = world->pair_capacity / 2;
+  uint32_t one[2];
+
+  if (room == 0) {
+    stage = one;
+    room = 1;
+  }
+
+  SortNewEndpoints(&e[sorted], count - sorted);
+  for (int first = sorted; first < count; first += room) {
+    int n = AK_FIXED_MIN(room, count - first);
+    for (int k = 0; k < n; k++) {
+      stage[2 * k] = (uint32_t)e[first + k].value;
+      stage[2 * k + 1] = (uint32_t)(uint16_t)e[first + k].body |
+                         (uint32_t)e[first + k].is_max << 16;
+    }
+    // Backwards, so every write lands on a slot already read
+    int i = first - 1;
+    int w = first + n - 1;
+    for (int k = n - 1; k >= 0; k--) {
+      ak_sap_endpoint_t next;
+      next.value = (ak_fixed_t)stage[2 * k];
+      next.body = (int16_t)(stage[2 * k + 1] & 0xFFFF);
+      next.is_max = (int16_t)(stage[2 * k + 1] >> 16);
+      next.handle = world->bodies[next.body].handle;
+      while (i >= 0 && EndpointLess(&next, &e[i]))
+        e[w--] = e[i--];
+      e[w--] = next;
+    }
+  }
+}
+
+static void DynamicPairs(ak_world_t *world, ak_pair_fn fn) {
+  ak_sap_t *sap = &world->sap;
+  ak_sap_endpoint_t *e = sap->endpoints;
+  int count = sap->endpoint_count;
+  int sorted = sap->sorted_count;
+
+  // Drop removed bodies, keeping the order of the rest
+  if (sap->moved) {
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+      int body = ak_world_body_index(world, e[i].handle);
+      if (i == sorted)
+        sorted = kept;
+      if (body < 0)
+        continue;
+      e[kept] = e[i];
+      e[kept++].body = (int16_t)body;
+    }
+    if (sorted > kept)
+      sorted = kept;
+    sap->endpoint_count = count = kept;
+    sap->moved = 0;
+  }
+
+  // Refresh cached extents
+  for (int i = 0; i < count; i++) {
+    ak_aabb_t box = ak_body_aabb(world, e[i].body);
+    if (e[i].is_max) {
+      e[i].value = box.max.x;
+      sap->min_y[e[i].body] = box.min.y;
+      sap->max_y[e[i].body] = box.max.y;
+    } else {
+      e[i].value = box.min.x;
+    }
+  }
+
+  // Insertion sort, cheap when the order barely changed since last step
+  for (int i = 1; i < sorted; i++) {
+    ak_sap_endpoint_t key = e[i];
+    int j = i - 1;
+    while (j >= 0 && EndpointLess(&key, &e[j])) {
+      e[j + 1] = e[j];
+      j--;
+    }
+    e[j + 1] = key;
+  }
+  if (sorted < count)
+    MergeNewEndpoints(world, sorted, count);
+  sap->sorted_count = count;
+
+  // Sweep
+  int active_count = 0;
+  for (int i = 0; i < count; i++) {
+    int a = e[i].body;
+
+    if (e[i].is_max) {
+      // Swap-remove from the active list
+      int slot = sap->active_slot[a];
+      int last = sap->active[--active_count];
+      sap->active[slot] = (int16_t)last;
+      sap->active_slot[last] = (int16_t)slot;
+      continue;
+    }
+
+    for (int k = 0; k < active_count; k++) {
+      int b = sap->active[k];
+      if (!Collides(world, a, b) || sap->max_y[a] < sap->min_y[b] ||
+          sap->max_y[b] < sap->min_y[a])
+        continue;
+      EmitPair(world, fn, a, b);
+    }
+
+    sap->active_slot[a] = (int16_t)active_count;
+    sap->active[active_count++] = (int16_t)a;
+  }
+}
+
+#elif AK_BROADPHASE == AK_BROADPHASE_TREE
+
+// --- Dynamic AABB Tree ---
+// Leaves hold fattened bounds, so a body is only re-inserted once it leaves
+// its margin. Insertion picks the sibling with the smallest perimeter growth
+// and rotations keep the tree height-balanced. All nodes come from a fixed
+// pool inside the world: a leaf per body plus one internal node per leaf.
+
+#define AK_NULL_NODE (-1)
+#define AK_PENDING_NODE (-2) // child2 of a leaf not yet in the tree
+
+// Pending leaves are chained both ways, next through parent and previous
+// through child1, so a removal can unlink and free its leaf at once.
+
+static ak_aabb_t Union(const ak_aabb_t *a, const ak_aabb_t *b) {
+  ak_aabb_t u = {{AK_FIXED_MIN(a->min.x, b->min.x),
+                  AK_FIXED_MIN(a->min.y, b->min.y)},
+                 {AK_FIXED_MAX(a->max.x, b->max.x),
+                  AK_FIXED_MAX(a->max.y, b->max.y)}};
+  return u;
+}
+
+// 64-bit so that world-sized boxes cannot overflow the cost sums
+static int64_t Perimeter(const ak_aabb_t *a) {
+  return 2 * ((int64_t)(a->max.x - a->min.x) + (a->max.y - a->min.y));
+}
+
+static int Contains(const ak_aabb_t *outer, const ak_aabb_t *inner) {
+  return outer->min.x <= inner->min.x && outer->min.y <= inner->min.y &&
+         inner->max.x <= outer->max.x && inner->max.y <= outer->max.y;
+}
+
+static ak_aabb_t FatBox(const ak_world_t *world, int body) {
+  const ak_tree_t *t = &world->tree;
+  ak_aabb_t box = ak_body_aabb(world, body);
+  box.min.x -= t->margin;
+  box.min.y -= t->margin;
+  box.max.x += t->margin;
+  box.max.y += t->margin;
+  return box;
+}
+
+// An inner node's filter is the union of its children's
+static void FitLayers(ak_tree_node_t *n, const ak_tree_node_t *c1,
+                      const ak_tree_node_t *c2) {
+  n->category = c1->category | c2->category;
+  n->mask = c1->mask | c2->mask;
+}
+
+static int AllocNode(ak_tree_t *t) {
+  int n = t->free_list;
+  ak_tree_node_t *node = &t->nodes[n];
+  t->free_list = node->parent;
+  node->parent = AK_NULL_NODE;
+  node->child1 = AK_NULL_NODE;
+  node->child2 = AK_NULL_NODE;
+  node->height = 0;
+  node->body = -1;
+  return n;
+}
+
+static void FreeNode(ak_tree_t *t, int n) {
+  t->nodes[n].parent = t->free_list;
+  t->nodes[n].height = -1;
+  t->free_list = n;
+}
+
+static void ReplaceChild(ak_tree_t *t, int parent, int old_child,
+                         int new_child) {
+  if (parent == AK_NULL_NODE) {
+    t->root = new_child;
+  } else if (t->nodes[parent].child1 == old_child) {
+    t->nodes[parent].child1 = new_child;
+  } else {
+    t->nodes[parent].child2 = new_child;
+  }
+}
+
+// Rotate node ia's taller grandchild up if its subtrees differ in height by
+// more than one. Returns the index now at ia's position.
+static int Balance(ak_tree_t *t, int ia) {
+  ak_tree_node_t *a = &t->nodes[ia];
+  if (a->child1 == AK_NULL_NODE || a->height < 2)
+    return ia;
+
+  int ib = a->child1;
+  int ic = a->child2;
+  ak_tree_node_t *b = &t->nodes[ib];
+  ak_tree_node_t *c = &t->nodes[ic];
+  int balance = c->height - b->height;
+
+  if (balance > 1) {
+    // Rotate C up
+    int i_f = c->child1;
+    int i_g = c->child2;
+    ak_tree_node_t *f = &t->nodes[i_f];
+    ak_tree_node_t *g = &t->nodes[i_g];
+
+    c->child1 = ia;
+    c->parent = a->parent;
+    a->parent = ic;
+    ReplaceChild(t, c->parent, ia, ic);
+
+    if (f->height > g->height) {
+      c->child2 = i_f;
+      a->child2 = i_g;
+      g->parent = ia;
+      a->box = Union(&b->box, &g->box);
+      c->box = Union(&a->box, &f->box);
+      FitLayers(a, b, g);
+      FitLayers(c, a, f);
+      a->height = 1 + AK_FIXED_MAX(b->height, g->height);
+      c->height = 1 + AK_FIXED_MAX(a->height, f->height);
+    } else {
+      c->child2 = i_g;
+      a->child2 = i_f;
+      f->parent = ia;
+      a->box = Union(&b->box, &f->box);
+      c->box = Union(&a->box, &g->box);
+      FitLayers(a, b, f);
+      FitLayers(c, a, g);
+      a->height = 1 + AK_FIXED_MAX(b->height, f->height);
+      c->height = 1 + AK_FIXED_MAX(a->height, g->height);
+    }
+    return ic;
+  }
+
+  if (balance < -1) {
+    // Rotate B up
+    int i_d = b->child1;
+    int i_e = b->child2;
+    ak_tree_node_t *d = &t->nodes[i_d];
+    ak_tree_node_t *e = &t->nodes[i_e];
+
+    b->child1 = ia;
+    b->parent = a->parent;
+    a->parent = ib;
+    ReplaceChild(t, b->parent, ia, ib);
+
+    if (d->height > e->height) {
+      b->child2 = i_d;
+      a->child1 = i_e;
+      e->parent = ia;
+      a->box = Union(&c->box, &e->box);
+      b->box = Union(&a->box, &d->box);
+      FitLayers(a, c, e);
+      FitLayers(b, a, d);
+      a->height = 1 + AK_FIXED_MAX(c->height, e->height);
+      b->height = 1 + AK_FIXED_MAX(a->height, d->height);
+    } else {
+      b->child2 = i_e;
+      a->child1 = i_d;
+      d->parent = ia;
+      a->box = Union(&c->box, &d->box);
+      b->box = Union(&a->box, &e->box);
+      FitLayers(a, c, d);
+      FitLayers(b, a, e);
+      a->height = 1 + AK_FIXED_MAX(c->height, d->height);
+      b->height = 1 + AK_FIXED_MAX(a->height, e->height);
+    }
+    return ib;
+  }
+
+  return ia;
+}
+
+// Walk from index to the root, rebalancing and refitting bounds
+static void Refit(ak_tree_t *t, int index) {
+  while (index != AK_NULL_NODE) {
+    index = Balance(t, index);
+    ak_tree_node_t *n = &t->nodes[index];
+    ak_tree_node_t *c1 = &t->nodes[n->child1];
+    ak_tree_node_t *c2 = &t->nodes[n->child2];
+    n->height = 1 + AK_FIXED_MAX(c1->height, c2->height);
+    n->box = Union(&c1->box, &c2->box);
+    FitLayers(n, c1, c2);
+    index = n->parent;
+  }
+}
+
+// leaf may also be the root of a whole subtree; only its box, height and
+// filter matter here.
+static void InsertLeaf(ak_tree_t *t, int leaf) {
+  if (t->root == AK_NULL_NODE) {
+    t->root = leaf;
+    t->nodes[leaf].parent = AK_NULL_NODE;
+    return;
+  }
+
+  // Descend towards the sibling with the cheapest perimeter growth
+  ak_aabb_t leaf_box = t->nodes[leaf].box;
+  int index = t->root;
+  while (t->nodes[index].child1 != AK_NULL_NODE) {
+    ak_tree_node_t *n = &t->nodes[index];
+    ak_aabb_t combined = Union(&n->box, &leaf_box);
+    int64_t combined_cost = Perimeter(&combined);
+    int64_t cost = 2 * combined_cost;
+    int64_t inherited = 2 * (combined_cost - Perimeter(&n->box));
+
+    int64_t child_cost[2];
+    int children[2] = {n->child1, n->child2};
+    for (int k = 0; k < 2; k++) {
+      ak_tree_node_t *c = &t->nodes[children[k]];
+      ak_aabb_t u = Union(&leaf_box, &c->box);
+      child_cost[k] = Perimeter(&u) + inherited;
+      if (c->child1 != AK_NULL_NODE)
+        child_cost[k] -= Perimeter(&c->box);
+    }
+
+    if (cost < child_cost[0] && cost < child_cost[1])
+      break;
+    index = child_cost[0] < child_cost[1] ? children[0] : children[1];
+  }
+
+  int sibling = index;
+  int old_parent = t->nodes[sibling].parent;
+  int new_parent = AllocNode(t);
+  ak_tree_node_t *p = &t->nodes[new_parent];
+  p->parent = old_parent;
+  p->box = Union(&leaf_box, &t->nodes[sibling].box);
+  p->height =
+      1 + AK_FIXED_MAX(t->nodes[sibling].height, t->nodes[leaf].height);
+  FitLayers(p, &t->nodes[sibling], &t->nodes[leaf]);
+  p->child1 = sibling;
+  p->child2 = leaf;
+  ReplaceChild(t, old_parent, sibling, new_parent);
+  t->nodes[sibling].parent = new_parent;
+  t->nodes[leaf].parent = new_parent;
+
+  Refit(t, t->nodes[leaf].parent);
+}
+
+static void RemoveLeaf(ak_tree_t *t, int leaf) {
+  if (leaf == t->root) {
+    t->root = AK_NULL_NODE;
+    return;
+  }
+
+  int parent = t->nodes[leaf].parent;
+  int grand_parent = t->nodes[parent].parent;
+  int sibling = t->nodes[parent].child1 == leaf ? t->nodes[parent].child2
+                                                 : t->nodes[parent].child1;
+
+  ReplaceChild(t, grand_parent, parent, sibling);
+  t->nodes[sibling].parent = grand_parent;
+  FreeNode(t, parent);
+  Refit(t, grand_parent);
+}
+
+// Subtrees holding nothing the filter of body accepts are skipped
+static void TreeQuery(ak_world_t *world, const ak_aabb_t *box,
+                      const ak_body_t *body, ak_leaf_fn fn, void *ctx) {
+  ak_tree_t *t = &world->tree;
+  int32_t stack[AK_TREE_STACK_SIZE];
+  int top = 0;
+
+  if (t->root == AK_NULL_NODE)
+    return;
+  stack[top++] = t->root;
+
+  while (top > 0) {
+    ak_tree_node_t *n = &t->nodes[stack[--top]];
+    if (!Overlaps(&n->box, box) ||
+        !NodeCollides(world, body, n->category, n->mask))
+      continue;
+    if (n->child1 == AK_NULL_NODE) {
+      if (!fn(world, n->body, ctx))
+        return;
+    } else if (top + 2 <= AK_TREE_STACK_SIZE) {
+      stack[top++] = n->child1;
+      stack[top++] = n->child2;
+    }
+  }
+}
+
+void ak_broadphase_init(ak_world_t *world) {
+  ak_tree_t *t = &world->tree;
+  int count = 2 * world->body_capacity;
+
+  for (int i = 0; i < count; i++) {
+    t->nodes[i].parent = i + 1 < count ? i + 1 : AK_NULL_NODE;
+    t->nodes[i].height = -1;
+  }
+  t->free_list = 0;
+  t->root = AK_NULL_NODE;
+  t->pending = AK_NULL_NODE;
+
+  ak_fixed_t scale_y = AK_FIXED_DIV(world->height, AK_INT_TO_FIXED(240));
+  t->margin = AK_FIXED_MUL(scale_y, AK_INT_TO_FIXED(AK_TREE_MARGIN));
+}
+
+// New bodies wait for the next update or query, which inserts them as one
+// batch (see InsertPending).
+void ak_broadphase_add(ak_world_t *world, int body) {
+  ak_tree_t *t = &world->tree;
+  int leaf = AllocNode(t);
+  t->nodes[leaf].body = (int16_t)body;
+  t->nodes[leaf].child2 = AK_PENDING_NODE;
+  t->nodes[leaf].parent = t->pending;
+  if (t->pending != AK_NULL_NODE)
+    t->nodes[t->pending].child1 = leaf;
+  t->pending = leaf;
+  t->leaf[body] = leaf;
+}
+
+void ak_broadphase_remove(ak_world_t *world, int body) {
+  ak_tree_t *t = &world->tree;
+  int leaf = t->leaf[body];
+  ak_tree_node_t *n = &t->nodes[leaf];
+  if (n->child2 == AK_PENDING_NODE) {
+    if (n->child1 == AK_NULL_NODE)
+      t->pending = n->parent;
+    else
+      t->nodes[n->child1].parent = n->parent;
+    if (n->parent != AK_NULL_NODE)
+      t->nodes[n->parent].child1 = n->child1;
+  } else {
+    RemoveLeaf(t, leaf);
+  }
+  FreeNode(t, leaf);
+}
+
+void ak_broadphase_move(ak_world_t *world, int from, int to) {
+  ak_tree_t *t = &world->tree;
+  t->leaf[to] = t->leaf[from];
+  t->nodes[t->leaf[to]].body = (int16_t)to;
+}
+
+// Pending leaves pick the filter up when they go in. Otherwise the unions
+// above the leaf are redone up to the first one that did not change.
+void ak_broadphase_refilter(ak_world_t *world, int body) {
+  ak_tree_t *t = &world->tree;
+  int index = t->leaf[body];
+  ak_tree_node_t *n = &t->nodes[index];
+  if (n->child2 == AK_PENDING_NODE)
+    return;
+  n->category = world->bodies[body].category;
+  n->mask = world->bodies[body].mask;
+
+  for (index = n->parent; index != AK_NULL_NODE; index = n->parent) {
+    n = &t->nodes[index];
+    uint16_t category = n->category;
+    uint16_t mask = n->mask;
+    FitLayers(n, &t->nodes[n->child1], &t->nodes[n->child2]);
+    if (n->category == category && n->mask == mask)
+      break;
+  }
+}
+
+// In 1/256 pixel units, so that a world-sized box fits in 64 bits
+static int64_t Area(const ak_aabb_t *a) {
+  return (int64_t)((a->max.x - a->min.x) >> 8) *
+         ((a->max.y - a->min.y) >> 8);
+}
+
+// Bodies added since the last update. A burst packed into a small area is
+// built into a tree of its own, which then goes into the main tree as one
+// subtree: the main tree is walked once instead of once per body. Scattered
+// bodies would make a subtree overlapping everything, so they go in one by
+// one.
+static void InsertPending(ak_world_t *world) {
+  ak_tree_t *t = &world->tree;
+  ak_aabb_t bounds = {{0, 0}, {0, 0}};
+  int64_t area = 0;
+  int found = 0;
+
+  for (int n = t->pending; n != AK_NULL_NODE; n = t->nodes[n].parent) {
+    ak_tree_node_t *leaf = &t->nodes[n];
+    leaf->box = FatBox(world, leaf->body);
+    leaf->category = world->bodies[leaf->body].category;
+    leaf->mask = world->bodies[leaf->body].mask;
+    bounds = found++ ? Union(&bounds, &leaf->box) : leaf->box;
+    area += Area(&leaf->box);
+  }
+  int burst = Area(&bounds) <= AK_TREE_BURST_SPREAD * area;
+
+  int root = t->root;
+  if (burst)
+    t->root = AK_NULL_NODE;
+  int n = t->pending;
+  while (n != AK_NULL_NODE) {
+    ak_tree_node_t *leaf = &t->nodes[n];
+    int next = leaf->parent;
+    leaf->child1 = AK_NULL_NODE;
+    leaf->child2 = AK_NULL_NODE;
+    InsertLeaf(t, n);
+    n = next;
+  }
+  t->pending = AK_NULL_NODE;
+  if (burst && t->root != AK_NULL_NODE) {
+    int subtree = t->root;
+    t->root = root;
+    InsertLeaf(t, subtree);
+  } else if (burst) {
+    t->root = root;
+  }
+}
+
+// Only awake bodies query the tree, so each overlapping pair is reported
+// once: by its lower-indexed body, or by the awake one if the other sleeps
+static int ReportPair(ak_world_t *world, int other, void *ctx) {
+  ak_pair_query_t *q = (ak_pair_query_t *)ctx;
+  if (other <= q->body && !ak_body_asleep(world, other))
+    return 1;
+  // Leaves are fattened; only tight overlaps go to the narrow phase
+  ak_aabb_t box = ak_body_aabb(world, other);
+  if (Overlaps(&q->box, &box))
+    EmitPair(world, q->fn, q->body, other);
+  return 1;
+}
+
+static void DynamicPairs(ak_world_t *world, ak_pair_fn fn) {
+  ak_tree_t *t = &world->tree;
+
+  InsertPending(world);
+  // Re-insert bodies that left their fattened bounds
+  for (int d = 0; d < world->dynamic_count; d++) {
+    int i = world->dynamic_bodies[d];
+    int leaf = t->leaf[i];
+    ak_aabb_t box = ak_body_aabb(world, i);
+    if (Contains(&t->nodes[leaf].box, &box))
+      continue;
+    RemoveLeaf(t, leaf);
+    t->nodes[leaf].box = FatBox(world, i);
+    InsertLeaf(t, leaf);
+  }
+
+  ak_pair_query_t q;
+  q.fn = fn;
+  for (int d = 0; d < world->dynamic_count; d++) {
+    q.body = world->dynamic_bodies[d];
+    if (ak_body_asleep(world, q.body))
+      continue;
+    q.box = ak_body_aabb(world, q.body);
+    TreeQuery(world, &q.box, &world->bodies[q.body], ReportPair, &q);
+  }
+}
+
+static void DynamicPacket(ak_world_t *world, ak_packet_t *p) {
+  ak_tree_t *t = &world->tree;
+  int32_t stack[AK_TREE_STACK_SIZE];
+  uint32_t masks[AK_TREE_STACK_SIZE];
+  int top = 0;
+
+  InsertPending(world);
+  if (t->root == AK_NULL_NODE)
+    return;
+  stack[top] = t->root;
+  masks[top++] = p->live;
+
+  while (top > 0) {
+    ak_tree_node_t *n = &t->nodes[stack[--top]];
+    uint32_t mask = masks[top] & p->live;
+    if (mask)
+      mask = p->test(&n->box, mask, p->ctx);
+    if (!mask)
+      continue;
+    if (n->child1 == AK_NULL_NODE) {
+      if (!ReportCandidate(world, n->body, mask, p))
+        return;
+    } else if (top + 2 <= AK_TREE_STACK_SIZE) {
+      stack[top] = n->child1;
+      masks[top++] = mask;
+      stack[top] = n->child2;
+      masks[top++] = mask;
+    }
+  }
+}
+
+#endif
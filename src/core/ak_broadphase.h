@@ -0,0 +1,63 @@
+#ifndef AK_BROADPHASE_H
+#define AK_BROADPHASE_H
+
+#include "ak_physics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Called once per candidate pair, always with body index a < b.
+typedef void (*ak_pair_fn)(ak_world_t *world, int a, int b);
+
+void ak_broadphase_init(ak_world_t *world);
+
+// Register a dynamic body that was just appended to world->bodies.
+void ak_broadphase_add(ak_world_t *world, int body);
+
+// Forget a dynamic body that is about to be removed.
+void ak_broadphase_remove(ak_world_t *world, int body);
+
+// A dynamic body's index changed from from to to, which was just freed.
+void ak_broadphase_move(ak_world_t *world, int from, int to);
+
+// A dynamic body's category or mask changed.
+void ak_broadphase_refilter(ak_world_t *world, int body);
+
+// Build the immutable BVH over world->statics.
+void ak_broadphase_bake_static(ak_world_t *world);
+
+/**
+ * Report every pair whose tight bounds overlap. Dynamic-vs-static pairs come
+ * from the baked static set; dynamic-vs-dynamic pairs from the structure
+ * chosen by AK_BROADPHASE. Static-vs-static pairs are never reported.
+ */
+void ak_broadphase_find_pairs(ak_world_t *world, ak_pair_fn fn);
+
+// --- Query packets ---
+// Up to AK_QUERY_PACKET user queries walk the structures together, one bit
+// of a mask each, so every node is fetched once per packet rather than once
+// per query.
+
+// Returns the queries of mask that may have answers inside box.
+typedef uint32_t (*ak_packet_test_fn)(const ak_aabb_t *box, uint32_t mask,
+                                      void *ctx);
+
+// Gets a body whose tight bounds passed test for the queries of mask, and
+// returns those of them that still want more bodies.
+typedef uint32_t (*ak_packet_fn)(ak_world_t *world, int body, uint32_t mask,
+                                 void *ctx);
+
+/**
+ * Offer every body to the queries of mask: static ones from the baked BVH,
+ * dynamic ones from the tree (AK_BROADPHASE_TREE) or a linear scan. Stops
+ * early once no query is left.
+ */
+void ak_broadphase_query_packet(ak_world_t *world, uint32_t mask,
+                                ak_packet_test_fn test, ak_packet_fn fn,
+                                void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AK_BROADPHASE_H
@@ -0,0 +1,244 @@
+#include "ak_checkpoint.h"
+#include "ak_contact_cache.h"
+
+#ifdef AK_CHECKPOINTS
+
+// A step replays from the slot holding the frame it is about to produce.
+// That slot still holds the rewound timeline until the step itself records
+// over it, so islands are planned and copied before end_step saves.
+
+static ak_checkpoint_t *Slot(ak_checkpoint_ring_t *ring, int32_t frame) {
+  return &ring->slots[frame % AK_CHECKPOINT_FRAMES];
+}
+
+static const ak_snapshot_header_t *Header(const ak_checkpoint_t *slot) {
+  return (const ak_snapshot_header_t *)slot->snapshot;
+}
+
+static const ak_snapshot_body_t *Bodies(const ak_checkpoint_t *slot) {
+  return (const ak_snapshot_body_t *)(Header(slot) + 1);
+}
+
+static const ak_cached_contact_t *Cached(const ak_checkpoint_t *slot) {
+  const ak_snapshot_header_t *h = Header(slot);
+  const ak_snapshot_tether_t *tethers =
+      (const ak_snapshot_tether_t *)(Bodies(slot) + h->body_count);
+  return (const ak_cached_contact_t *)(tethers + h->tether_count);
+}
+
+// Saves the world as it is now, after the step that produced world->frame
+static void Record(ak_world_t *world, int replayable) {
+  ak_checkpoint_ring_t *ring = world->checkpoints;
+  ak_checkpoint_t *slot = Slot(ring, world->frame);
+
+  slot->size = ak_world_save(world, slot->snapshot, sizeof(slot->snapshot));
+  slot->frame = world->frame;
+  // A full cache may have dropped impulses the replay would need
+  slot->replayable = replayable &&
+                     Header(slot)->cached_count < world->contact_cache.capacity;
+  if (!slot->replayable)
+    return;
+
+  // Islands are numbered in order of their lowest body, so the first body
+  // met in each is its root
+  int16_t *first = ring->first;
+  for (int k = 0; k < world->island_count; k++)
+    first[k] = -1;
+  for (int i = 0; i < world->body_count; i++) {
+    int k = world->island_of[i];
+    if (k < 0) {
+      slot->island_root[i] = -1;
+      continue;
+    }
+    if (first[k] < 0)
+      first[k] = (int16_t)i;
+    slot->island_root[i] = first[k];
+  }
+}
+
+int ak_world_attach_checkpoints(ak_world_t *world,
+                                ak_checkpoint_ring_t *ring) {
+  // Slots and per-body arrays are sized for the AK_MAX_* capacities
+  if (ring && (world->body_capacity > AK_MAX_BODIES ||
+               world->tether_capacity > AK_MAX_TETHERS ||
+               world->contact_cache.capacity > AK_MAX_CACHED_CONTACTS))
+    return 0;
+  world->checkpoints = ring;
+  if (!ring)
+    return 1;
+  for (int s = 0; s < AK_CHECKPOINT_FRAMES; s++)
+    ring->slots[s].frame = -1;
+  for (int i = 0; i < world->body_capacity; i++)
+    ring->dirty[i] = 0;
+  ring->replay_until = -1;
+  ring->replaying = 0;
+  // The islands that led here are unknown, so this frame is only a restore
+  // point
+  Record(world, 0);
+  return 1;
+}
+
+int ak_world_rewind(ak_world_t *world, int frames) {
+  ak_checkpoint_ring_t *ring = world->checkpoints;
+  int32_t target = world->frame - frames;
+
+  if (!ring || frames < 0 || frames >= AK_CHECKPOINT_FRAMES || target < 0)
+    return 0;
+  ak_checkpoint_t *slot = Slot(ring, target);
+  if (slot->frame != target ||
+      !ak_world_restore(world, slot->snapshot, slot->size))
+    return 0;
+
+  // Only frames up to here belong to the timeline being replaced; anything
+  // later in the ring is from one rewound earlier.
+  ring->replay_until = world->frame;
+  ring->replaying = 0;
+  for (int i = 0; i < world->body_count; i++)
+    ring->dirty[i] = 0;
+  world->frame = target;
+  return 1;
+}
+
+void ak_world_mark_dirty(ak_world_t *world, ak_body_t *body) {
+  if (world->checkpoints)
+    world->checkpoints->dirty[body->id] = 1;
+}
+
+// --- Replay ---
+
+static int FindRoot(int16_t *parent, int i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+static void Union(int16_t *parent, int a, int b) {
+  int ra = FindRoot(parent, a);
+  int rb = FindRoot(parent, b);
+  if (ra < rb)
+    parent[rb] = (int16_t)ra;
+  else if (rb < ra)
+    parent[ra] = (int16_t)rb;
+}
+
+// Called once the last batch's islands are built. A body stays clean only if
+// nothing it shares an island with, in this step or the recorded one, is
+// dirty; dirtiness spreads along both and never clears until the next
+// rewind. Islands of clean bodies then hold exactly the rows they held when
+// recorded, so their solve can be copied.
+void ak_checkpoint_plan_replay(ak_world_t *world) {
+  ak_checkpoint_ring_t *ring = world->checkpoints;
+  int32_t frame = world->frame + 1; // Being produced
+  const ak_checkpoint_t *slot = Slot(ring, frame);
+
+  ring->replaying = 0;
+  if (frame > ring->replay_until)
+    return;
+  if (slot->frame != frame || !slot->replayable ||
+      world->stats.batches != 1 ||
+      Header(slot)->body_count != world->body_count) {
+    ring->replay_until = world->frame; // Resimulate everything from here
+    return;
+  }
+
+  int16_t *parent = ring->parent;
+  int16_t *first = ring->first;
+  uint8_t *dirty = ring->dirty;
+  for (int i = 0; i < world->body_count; i++)
+    parent[i] = (int16_t)i;
+  for (int k = 0; k < world->island_count; k++)
+    first[k] = -1;
+  for (int d = 0; d < world->dynamic_count; d++) {
+    int i = world->dynamic_bodies[d];
+    int k = world->island_of[i];
+    if (first[k] < 0)
+      first[k] = (int16_t)i;
+    else
+      Union(parent, i, first[k]);
+    if (slot->island_root[i] >= 0)
+      Union(parent, i, slot->island_root[i]);
+  }
+
+  // Roots first, then everything under them
+  for (int i = 0; i < world->body_count; i++) {
+    if (dirty[i])
+      dirty[FindRoot(parent, i)] = 1;
+  }
+  for (int i = 0; i < world->body_count; i++)
+    dirty[i] = dirty[FindRoot(parent, i)];
+
+  for (int k = 0; k < world->island_count; k++)
+    ring->replay_island[k] = 1;
+  for (int d = 0; d < world->dynamic_count; d++) {
+    int i = world->dynamic_bodies[d];
+    if (dirty[i])
+      ring->replay_island[world->island_of[i]] = 0;
+  }
+  ring->replaying = 1;
+}
+
+// Called by the solver for island k, possibly from a worker thread. Returns 1
+// if the island is clean, after loading the recorded impulse of each of its
+// contacts for the cache to store. Bodies are copied in end_step.
+int ak_checkpoint_replay_island(ak_world_t *world, int k) {
+  const ak_checkpoint_ring_t *ring = world->checkpoints;
+  if (!ring->replaying || !ring->replay_island[k])
+    return 0;
+
+  const ak_checkpoint_t *slot =
+      &ring->slots[(world->frame + 1) % AK_CHECKPOINT_FRAMES];
+  const ak_cached_contact_t *entries = Cached(slot);
+  int count = Header(slot)->cached_count;
+  const ak_island_t *island = &world->islands[k];
+  const int *rows = &world->island_rows[island->first_row];
+
+  for (int r = 0; r < island->row_count; r++) {
+    if (rows[r] >= world->contact_count)
+      continue; // Tether rows are not cached
+    ak_contact_t *m = &world->contacts[rows[r]];
+    uint32_t key = ak_contact_cache_key(world, m->body_a_id, m->body_b_id);
+    int lo = 0, hi = count;
+    while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (entries[mid].key < key)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    m->normal_impulse =
+        (lo < count && entries[lo].key == key) ? entries[lo].normal_impulse : 0;
+  }
+  return 1;
+}
+
+void ak_checkpoint_end_step(ak_world_t *world) {
+  ak_checkpoint_ring_t *ring = world->checkpoints;
+
+  if (ring->replaying) {
+    const ak_snapshot_body_t *bodies = Bodies(Slot(ring, world->frame));
+    int32_t asleep = 0;
+    for (int d = 0; d < world->dynamic_count; d++) {
+      int i = world->dynamic_bodies[d];
+      if (!ring->dirty[i]) {
+        AK_BODY_POS_X(world, i) = bodies[i].pos_x;
+        AK_BODY_POS_Y(world, i) = bodies[i].pos_y;
+        AK_BODY_VEL_X(world, i) = bodies[i].vel_x;
+        AK_BODY_VEL_Y(world, i) = bodies[i].vel_y;
+        AK_BODY_FORCE_X(world, i) = bodies[i].force_x;
+        AK_BODY_FORCE_Y(world, i) = bodies[i].force_y;
+        AK_BODY_SLEEP_TIME(world, i) = bodies[i].sleep_time;
+#ifdef AK_HASH
+        ak_world_rehash_body(world, &world->bodies[i]);
+#endif
+      }
+      asleep += ak_body_asleep(world, i);
+    }
+    world->stats.asleep = asleep;
+    ring->replaying = 0;
+  }
+  Record(world, world->stats.batches == 1);
+}
+
+#endif // AK_CHECKPOINTS
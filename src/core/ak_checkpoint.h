@@ -0,0 +1,80 @@
+#ifndef AK_CHECKPOINT_H
+#define AK_CHECKPOINT_H
+
+#include "ak_physics.h"
+#include "ak_snapshot.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef AK_CHECKPOINTS
+
+// Frames of history kept by a checkpoint ring
+#ifndef AK_CHECKPOINT_FRAMES
+#define AK_CHECKPOINT_FRAMES 8
+#endif
+
+typedef struct {
+  int32_t frame; // Frame this slot holds, -1 if empty
+  int32_t size;  // Snapshot bytes
+  int replayable; // island_root is valid (the step ran as a single batch)
+  // Lowest body id of each body's island in the step that produced the
+  // snapshot, -1 for static bodies
+  int16_t island_root[AK_MAX_BODIES];
+  uint32_t snapshot[(AK_SNAPSHOT_MAX_BYTES + 3) / 4];
+} ak_checkpoint_t;
+
+// The state of the world at the end of each of the last AK_CHECKPOINT_FRAMES
+// steps, recorded by every step once attached. Owned by the caller (it is
+// far too big to live inside ak_world_t on small targets).
+typedef struct ak_checkpoint_ring {
+  ak_checkpoint_t slots[AK_CHECKPOINT_FRAMES];
+  // After a rewind, frames up to replay_until still hold the timeline that
+  // was rewound from; islands untouched by changed input are copied from
+  // them instead of being solved again.
+  int32_t replay_until;
+  int replaying; // The current step copies clean islands
+  uint8_t dirty[AK_MAX_BODIES];         // Body may differ from the record
+  uint8_t replay_island[AK_MAX_BODIES]; // Per island of the current step
+  int16_t parent[AK_MAX_BODIES];        // Scratch: union-find
+  int16_t first[AK_MAX_BODIES];         // Scratch: lowest body per island
+} ak_checkpoint_ring_t;
+
+/**
+ * Record every step of world into ring, starting with the current state.
+ * Pass NULL to stop recording. Returns 0 if world can hold more than the
+ * ring's AK_MAX_* capacities.
+ */
+int ak_world_attach_checkpoints(ak_world_t *world,
+                                ak_checkpoint_ring_t *ring);
+
+/**
+ * Restore the state recorded `frames` steps ago (0 <= frames <
+ * AK_CHECKPOINT_FRAMES) and set world->frame back to it. Returns 0, leaving
+ * world untouched, if that frame is no longer in the ring.
+ *
+ * Stepping forward again replays the recorded timeline: an island is only
+ * solved if it holds a body marked with ak_world_mark_dirty or touched one
+ * in either timeline; every other island is copied from the record. The
+ * result is bit-identical to a full resimulation as long as every body whose
+ * input differs from the recorded run is marked before its step (typically
+ * from the ak_world_step_n input callback).
+ */
+int ak_world_rewind(ak_world_t *world, int frames);
+
+// The body's input differs from the recorded timeline; resimulate it and
+// everything it touches from now on.
+void ak_world_mark_dirty(ak_world_t *world, ak_body_t *body);
+
+// Step hooks, called by ak_world_step.
+void ak_checkpoint_plan_replay(ak_world_t *world);
+int ak_checkpoint_replay_island(ak_world_t *world, int island);
+void ak_checkpoint_end_step(ak_world_t *world);
+
+#endif // AK_CHECKPOINTS
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AK_CHECKPOINT_H
@@ -0,0 +1,129 @@
+#include "ak_contact_cache.h"
+
+static uint32_t ContactKey(const ak_world_t *world, const ak_contact_t *c) {
+  return ak_contact_cache_key(world, c->body_a_id, c->body_b_id);
+}
+
+void ak_contact_cache_init(ak_world_t *world) {
+  ak_contact_cache_t *cache = &world->contact_cache;
+  cache->count[0] = 0;
+  cache->count[1] = 0;
+  cache->front = 0;
+  cache->sorted = 1;
+}
+
+// A batch comes out of the narrow phase in key order (as long as no body
+// removal has reordered the handle slots), so each lookup only searches past
+// the previous one.
+void ak_contact_cache_fetch(ak_world_t *world) {
+  const ak_contact_cache_t *cache = &world->contact_cache;
+  const ak_cached_contact_t *entries = cache->entries[cache->front];
+  int count = cache->count[cache->front];
+  uint32_t last = 0;
+  int lo = 0;
+
+  for (int c = 0; c < world->contact_count; c++) {
+    ak_contact_t *m = &world->contacts[c];
+    uint32_t key = ContactKey(world, m);
+    if (key < last)
+      lo = 0;
+    last = key;
+    int hi = count;
+    while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (entries[mid].key < key)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    m->normal_impulse =
+        (lo < count && entries[lo].key == key) ? entries[lo].normal_impulse : 0;
+  }
+}
+
+void ak_contact_cache_store(ak_world_t *world) {
+  ak_contact_cache_t *cache = &world->contact_cache;
+  int back = cache->front ^ 1;
+  ak_cached_contact_t *entries = cache->entries[back];
+  int count = cache->count[back];
+
+  for (int c = 0; c < world->contact_count; c++) {
+    const ak_contact_t *m = &world->contacts[c];
+    if (count == cache->capacity)
+      break;
+    // Rows that ended up pushing nothing have nothing to warm start
+    if (m->normal_impulse == 0)
+      continue;
+    uint32_t key = ContactKey(world, m);
+    if (count > 0 && entries[count - 1].key > key)
+      cache->sorted = 0;
+    entries[count].key = key;
+    entries[count].normal_impulse = m->normal_impulse;
+    count++;
+  }
+  cache->count[back] = count;
+}
+
+// LSD radix sort on the keys, as the narrow phase sorts its pairs. Returns
+// whichever buffer ends up sorted.
+#if AK_MAX_CACHED_CONTACTS > 256
+#define AK_CACHE_RADIX_BITS 8
+#else
+#define AK_CACHE_RADIX_BITS 4
+#endif
+#define AK_CACHE_RADIX_SIZE (1 << AK_CACHE_RADIX_BITS)
+
+static ak_cached_contact_t *SortEntries(ak_cached_contact_t *entries,
+                                        ak_cached_contact_t *scratch, int n) {
+  uint32_t all_or = 0;
+  uint32_t all_and = 0xFFFFFFFFu;
+  for (int i = 0; i < n; i++) {
+    all_or |= entries[i].key;
+    all_and &= entries[i].key;
+  }
+  uint32_t varying = all_or ^ all_and;
+
+  for (int shift = 0; shift < 32; shift += AK_CACHE_RADIX_BITS) {
+    if (!((varying >> shift) & (AK_CACHE_RADIX_SIZE - 1)))
+      continue;
+
+    int32_t start[AK_CACHE_RADIX_SIZE] = {0};
+    for (int i = 0; i < n; i++)
+      start[(entries[i].key >> shift) & (AK_CACHE_RADIX_SIZE - 1)]++;
+    int32_t sum = 0;
+    for (int d = 0; d < AK_CACHE_RADIX_SIZE; d++) {
+      int32_t c = start[d];
+      start[d] = sum;
+      sum += c;
+    }
+    for (int i = 0; i < n; i++)
+      scratch[start[(entries[i].key >> shift) & (AK_CACHE_RADIX_SIZE - 1)]++] =
+          entries[i];
+
+    ak_cached_contact_t *t = entries;
+    entries = scratch;
+    scratch = t;
+  }
+  return entries;
+}
+
+// Only a step whose pairs were flushed in several batches records its
+// contacts out of order; the old front buffer is free to sort through.
+void ak_contact_cache_commit(ak_world_t *world) {
+  ak_contact_cache_t *cache = &world->contact_cache;
+  int back = cache->front ^ 1;
+
+  if (!cache->sorted) {
+    ak_cached_contact_t *sorted =
+        SortEntries(cache->entries[back], cache->entries[cache->front],
+                    cache->count[back]);
+    if (sorted != cache->entries[back]) {
+      cache->count[cache->front] = cache->count[back];
+      back = cache->front;
+    }
+  }
+
+  cache->front = back;
+  cache->count[back ^ 1] = 0;
+  cache->sorted = 1;
+}
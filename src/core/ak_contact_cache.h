@@ -0,0 +1,36 @@
+#ifndef AK_CONTACT_CACHE_H
+#define AK_CONTACT_CACHE_H
+
+#include "ak_narrowphase.h"
+#include "ak_physics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cache key of the contact between bodies a and b: a pair key of their
+// handle slots, which stay put when another body's removal moves them.
+static inline uint32_t ak_contact_cache_key(const ak_world_t *world, int a,
+                                            int b) {
+  int sa = AK_HANDLE_SLOT(world->bodies[a].handle);
+  int sb = AK_HANDLE_SLOT(world->bodies[b].handle);
+  int kind = AK_PAIR_KIND(world, a, b);
+  return sa < sb ? AK_PAIR_KEY(kind, sa, sb) : AK_PAIR_KEY(kind, sb, sa);
+}
+
+void ak_contact_cache_init(ak_world_t *world);
+
+// Load last step's accumulated impulse into each of world->contacts, or 0 for
+// pairs that were not touching.
+void ak_contact_cache_fetch(ak_world_t *world);
+
+// Record the impulses of the contacts just solved for the next step.
+void ak_contact_cache_store(ak_world_t *world);
+
+// End of step: this step's records become the ones fetched next step.
+void ak_contact_cache_commit(ak_world_t *world);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AK_CONTACT_CACHE_H
@@ -8,8 +8,8 @@ void ak_demo_create_standard_scene(ak_world_t *world) {
   ak_fixed_t scaled_ref_width = AK_FIXED_MUL(AK_INT_TO_FIXED(320), scale);
   ak_fixed_t offset_x = (world->width - scaled_ref_width) / 2;
 
-  ak_world_init(world, world->width, world->height,
-                (ak_vec2_t){0, AK_FIXED_MUL(AK_INT_TO_FIXED(50), scale)});
+  ak_world_reset(world, world->width, world->height,
+                 (ak_vec2_t){0, AK_FIXED_MUL(AK_INT_TO_FIXED(50), scale)});
 
   // 1. Ground (Static AABB)
   ak_world_add_body(
@@ -77,7 +77,7 @@ void ak_demo_create_standard_scene(ak_world_t *world) {
       offset_x + AK_FIXED_MUL(AK_INT_TO_FIXED(160), scale),
       AK_FIXED_MUL(AK_INT_TO_FIXED(60), scale), AK_INT_TO_FIXED(2));
 
-  b2->velocity.x = AK_FIXED_MUL(AK_INT_TO_FIXED(20), scale);
+  AK_BODY_VEL_X(world, b2->id) = AK_FIXED_MUL(AK_INT_TO_FIXED(20), scale);
 
   ak_world_add_tether(world, b1, b2, AK_FIXED_MUL(AK_INT_TO_FIXED(40), scale));
   ak_world_add_tether(world, b2, b3, AK_FIXED_MUL(AK_INT_TO_FIXED(40), scale));
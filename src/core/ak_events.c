@@ -0,0 +1,229 @@
+#include "ak_events.h"
+#include "ak_contact_cache.h"
+#include <stddef.h>
+
+#ifdef AK_EVENTS
+
+// What a step found of a pair touching at the end of the last one
+#define AK_TOUCH_UNSEEN 0  // Not touching any more: ends
+#define AK_TOUCH_SEEN 1    // Touching again: persists
+#define AK_TOUCH_DORMANT 2 // Skipped by the narrow phase, nothing awake
+
+int ak_event_ring_init(ak_event_ring_t *ring, ak_contact_event_t *events,
+                       int capacity, ak_contact_touch_t *touching,
+                       int touch_capacity) {
+  if (capacity <= 0 || (capacity & (capacity - 1)) != 0)
+    return 0;
+  ring->events = events;
+  ring->capacity = (uint32_t)capacity;
+  ring->write = 0;
+  ring->read = 0;
+  ring->overflow = 0;
+  ring->untracked = 0;
+  ring->types = AK_EVENT_ALL;
+  ring->filter = NULL;
+  ring->filter_user = NULL;
+  ring->touching[0] = touching;
+  ring->touching[1] = touching + touch_capacity;
+  ring->touch_capacity = touch_capacity;
+  ring->touch_count[0] = 0;
+  ring->touch_count[1] = 0;
+  ring->front = 0;
+  ring->sorted = 1;
+  return 1;
+}
+
+void ak_world_set_event_ring(ak_world_t *world, ak_event_ring_t *ring) {
+  world->events = ring;
+  if (!ring)
+    return;
+  ring->touch_count[0] = 0;
+  ring->touch_count[1] = 0;
+  ring->front = 0;
+  ring->sorted = 1;
+}
+
+const ak_contact_event_t *ak_event_ring_next(ak_event_ring_t *ring) {
+  if (ring->read == ring->write)
+    return NULL;
+  return &ring->events[ring->read++ & (ring->capacity - 1)];
+}
+
+// A full ring keeps its unread events and drops the new one
+static void Emit(ak_event_ring_t *ring, int type, const ak_contact_touch_t *t,
+                 int a, int b, ak_vec2_t normal, ak_fixed_t impulse) {
+  if (!(ring->types & AK_EVENT_BIT(type)))
+    return;
+  if (ring->write - ring->read == ring->capacity) {
+    ring->overflow++;
+    return;
+  }
+  ak_contact_event_t *e = &ring->events[ring->write++ & (ring->capacity - 1)];
+  e->a = t->a;
+  e->b = t->b;
+  e->body_a = (int16_t)a;
+  e->body_b = (int16_t)b;
+  e->type = (int16_t)type;
+  e->normal = normal;
+  e->impulse = impulse;
+}
+
+// Static bodies are never awake, so a pair with nothing awake in it is left
+// out of the narrow phase
+static int Awake(const ak_world_t *world, int i) {
+  return !world->bodies[i].is_static && !ak_body_asleep(world, i);
+}
+
+// Adds a pair to this step's buffer, noting whether it broke key order
+static void Track(ak_event_ring_t *ring, const ak_contact_touch_t *t) {
+  int back = ring->front ^ 1;
+  int count = ring->touch_count[back];
+  ak_contact_touch_t *entries = ring->touching[back];
+
+  if (count == ring->touch_capacity) {
+    ring->untracked++;
+    return;
+  }
+  if (count > 0 && entries[count - 1].key > t->key)
+    ring->sorted = 0;
+  entries[count] = *t;
+  entries[count].state = AK_TOUCH_UNSEEN;
+  ring->touch_count[back] = count + 1;
+}
+
+// Pairs whose bodies were all asleep or static before the broadphase are
+// not collided, but still touch. Bodies removed since count as awake.
+void ak_events_begin_step(ak_world_t *world) {
+  ak_event_ring_t *ring = world->events;
+  ak_contact_touch_t *last = ring->touching[ring->front];
+
+  for (int k = 0; k < ring->touch_count[ring->front]; k++) {
+    int a = ak_world_body_index(world, last[k].a);
+    int b = ak_world_body_index(world, last[k].b);
+    last[k].state = (a >= 0 && b >= 0 && !Awake(world, a) && !Awake(world, b))
+                        ? AK_TOUCH_DORMANT
+                        : AK_TOUCH_UNSEEN;
+  }
+}
+
+// Called after each batch is solved. Contacts come in key order within a
+// batch, so each lookup only searches past the previous one, as in the
+// contact cache. A key alone could name a removed body's successor in its
+// handle slot, so the handles must match too.
+void ak_events_record(ak_world_t *world) {
+  ak_event_ring_t *ring = world->events;
+  ak_contact_touch_t *last = ring->touching[ring->front];
+  int last_count = ring->touch_count[ring->front];
+  uint32_t prev = 0;
+  int lo = 0;
+
+  for (int c = 0; c < world->contact_count; c++) {
+    const ak_contact_t *m = &world->contacts[c];
+    ak_contact_touch_t t;
+    int type = AK_CONTACT_BEGIN;
+
+    t.key = ak_contact_cache_key(world, m->body_a_id, m->body_b_id);
+    t.a = world->bodies[m->body_a_id].handle;
+    t.b = world->bodies[m->body_b_id].handle;
+    if (t.key < prev)
+      lo = 0;
+    prev = t.key;
+    int hi = last_count;
+    while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (last[mid].key < t.key)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    if (lo < last_count && last[lo].key == t.key &&
+        ((last[lo].a == t.a && last[lo].b == t.b) ||
+         (last[lo].a == t.b && last[lo].b == t.a))) {
+      last[lo].state = AK_TOUCH_SEEN;
+      t.report = last[lo].report;
+      type = AK_CONTACT_PERSIST;
+    } else {
+      t.report = (int16_t)(!ring->filter ||
+                           ring->filter(world, m->body_a_id, m->body_b_id,
+                                        ring->filter_user));
+    }
+    Track(ring, &t);
+    if (t.report)
+      Emit(ring, type, &t, m->body_a_id, m->body_b_id, m->normal,
+           m->normal_impulse);
+  }
+}
+
+// LSD radix sort on the keys, as the contact cache sorts its entries.
+// Returns whichever buffer ends up sorted.
+#define AK_TOUCH_RADIX_BITS 4
+#define AK_TOUCH_RADIX_SIZE (1 << AK_TOUCH_RADIX_BITS)
+
+static ak_contact_touch_t *SortTouching(ak_contact_touch_t *entries,
+                                        ak_contact_touch_t *scratch, int n) {
+  uint32_t all_or = 0;
+  uint32_t all_and = 0xFFFFFFFFu;
+  for (int i = 0; i < n; i++) {
+    all_or |= entries[i].key;
+    all_and &= entries[i].key;
+  }
+  uint32_t varying = all_or ^ all_and;
+
+  for (int shift = 0; shift < 32; shift += AK_TOUCH_RADIX_BITS) {
+    if (!((varying >> shift) & (AK_TOUCH_RADIX_SIZE - 1)))
+      continue;
+
+    int32_t start[AK_TOUCH_RADIX_SIZE] = {0};
+    for (int i = 0; i < n; i++)
+      start[(entries[i].key >> shift) & (AK_TOUCH_RADIX_SIZE - 1)]++;
+    int32_t sum = 0;
+    for (int d = 0; d < AK_TOUCH_RADIX_SIZE; d++) {
+      int32_t c = start[d];
+      start[d] = sum;
+      sum += c;
+    }
+    for (int i = 0; i < n; i++)
+      scratch[start[(entries[i].key >> shift) & (AK_TOUCH_RADIX_SIZE - 1)]++] =
+          entries[i];
+
+    ak_contact_touch_t *t = entries;
+    entries = scratch;
+    scratch = t;
+  }
+  return entries;
+}
+
+// Last step's pairs that were not touched again end, unless they slept
+// through the step; those carry over. Then this step's pairs become the
+// ones looked up next step.
+void ak_events_end_step(ak_world_t *world) {
+  ak_event_ring_t *ring = world->events;
+  ak_contact_touch_t *last = ring->touching[ring->front];
+  int back = ring->front ^ 1;
+
+  for (int k = 0; k < ring->touch_count[ring->front]; k++) {
+    const ak_contact_touch_t *t = &last[k];
+    if (t->state == AK_TOUCH_DORMANT) {
+      Track(ring, t);
+    } else if (t->state == AK_TOUCH_UNSEEN && t->report) {
+      Emit(ring, AK_CONTACT_END, t, ak_world_body_index(world, t->a),
+           ak_world_body_index(world, t->b), (ak_vec2_t){0, 0}, 0);
+    }
+  }
+
+  if (!ring->sorted) {
+    ak_contact_touch_t *sorted = SortTouching(
+        ring->touching[back], last, ring->touch_count[back]);
+    if (sorted != ring->touching[back]) {
+      ring->touch_count[ring->front] = ring->touch_count[back];
+      back = ring->front;
+    }
+  }
+
+  ring->front = back;
+  ring->touch_count[back ^ 1] = 0;
+  ring->sorted = 1;
+}
+
+#endif // AK_EVENTS
@@ -0,0 +1,94 @@
+#ifndef AK_EVENTS_H
+#define AK_EVENTS_H
+
+#include "ak_physics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef AK_EVENTS
+
+#define AK_CONTACT_BEGIN 0   // The bodies started touching this step
+#define AK_CONTACT_PERSIST 1 // Still touching
+#define AK_CONTACT_END 2     // Stopped touching, or one of them was removed
+
+#define AK_EVENT_BIT(type) (1 << (type))
+#define AK_EVENT_ALL                                                           \
+  (AK_EVENT_BIT(AK_CONTACT_BEGIN) | AK_EVENT_BIT(AK_CONTACT_PERSIST) |         \
+   AK_EVENT_BIT(AK_CONTACT_END))
+
+typedef struct {
+  ak_body_handle_t a, b;
+  int16_t body_a, body_b; // Ids after the step, -1 for a removed body
+  int16_t type;           // AK_CONTACT_*
+  ak_vec2_t normal;       // Unit, from a to b; 0 for AK_CONTACT_END
+  // Normal impulse the contact applied this step (restitution excluded); 0
+  // for AK_CONTACT_END
+  ak_fixed_t impulse;
+} ak_contact_event_t;
+
+// A pair touching at the end of a step
+typedef struct {
+  uint32_t key; // Contact cache key (ak_contact_cache_key)
+  ak_body_handle_t a, b;
+  int16_t report; // The filter accepted the pair when it began
+  int16_t state;  // Step scratch: unseen, touched again or dormant
+} ak_contact_touch_t;
+
+// Return 0 to drop every event of the pair of bodies a and b. Called once,
+// when they begin touching.
+typedef int (*ak_event_filter_fn)(const ak_world_t *world, int a, int b,
+                                  void *user);
+
+// Contact events written by every step once attached, read in order with
+// ak_event_ring_next. Owned by the caller, as is all of its storage.
+typedef struct ak_event_ring {
+  ak_contact_event_t *events; // capacity entries
+  uint32_t capacity;          // A power of two
+  uint32_t write, read;       // Free running; write - read are unread
+  uint32_t overflow;          // Events dropped because the ring was full
+  uint32_t untracked;         // Touching pairs that did not fit in touching
+  int types;                  // AK_EVENT_BIT of each type to write
+  ak_event_filter_fn filter;  // NULL reports every pair
+  void *filter_user;
+  // Double-buffered like the contact cache: touching[front] holds last
+  // step's pairs sorted by key, the other buffer collects this step's.
+  ak_contact_touch_t *touching[2]; // touch_capacity entries each
+  int touch_capacity;
+  int touch_count[2];
+  int front;
+  int sorted; // This step's pairs were recorded in key order
+} ak_event_ring_t;
+
+/**
+ * Set up ring over caller storage: events holds capacity entries (a power of
+ * two) and touching 2 * touch_capacity, enough for every contact of a step.
+ * Writes every event type, unfiltered. Returns 0 if capacity is not a power
+ * of two.
+ */
+int ak_event_ring_init(ak_event_ring_t *ring, ak_contact_event_t *events,
+                       int capacity, ak_contact_touch_t *touching,
+                       int touch_capacity);
+
+/**
+ * Write the events of every step of world into ring; NULL detaches it. The
+ * ring starts with nothing touching, so attaching (again, e.g. after loading
+ * a snapshot) reports every current contact as beginning.
+ */
+void ak_world_set_event_ring(ak_world_t *world, ak_event_ring_t *ring);
+
+// Oldest unread event, or NULL once every event has been read
+const ak_contact_event_t *ak_event_ring_next(ak_event_ring_t *ring);
+
+// Step hooks, called by ak_world_step.
+void ak_events_begin_step(ak_world_t *world);
+void ak_events_record(ak_world_t *world);
+void ak_events_end_step(ak_world_t *world);
+
+#endif // AK_EVENTS
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AK_EVENTS_H
@@ -0,0 +1,279 @@
+#include "ak_narrowphase.h"
+#include "ak_simd.h"
+
+void ak_narrowphase_add_pair(ak_world_t *world, int a, int b) {
+  world->pairs[world->pair_count++] =
+      AK_PAIR_KEY(AK_PAIR_KIND(world, a, b), a, b);
+}
+
+// LSD radix sort. Digits every key agrees on are skipped, so the sparse key
+// layout costs only a few passes. Small pair buffers use 4-bit digits to keep
+// the counter table at 16 entries on the 8/16-bit targets. Returns whichever
+// buffer ends up sorted.
+#if AK_MAX_PAIRS > 256
+#define AK_RADIX_BITS 8
+#else
+#define AK_RADIX_BITS 4
+#endif
+#define AK_RADIX_SIZE (1 << AK_RADIX_BITS)
+
+static uint32_t *SortPairs(uint32_t *keys, uint32_t *scratch, int n) {
+  uint32_t all_or = 0;
+  uint32_t all_and = 0xFFFFFFFFu;
+  for (int i = 0; i < n; i++) {
+    all_or |= keys[i];
+    all_and &= keys[i];
+  }
+  uint32_t varying = all_or ^ all_and;
+
+  for (int shift = 0; shift < 32; shift += AK_RADIX_BITS) {
+    if (!((varying >> shift) & (AK_RADIX_SIZE - 1)))
+      continue;
+
+    int32_t start[AK_RADIX_SIZE] = {0};
+    for (int i = 0; i < n; i++)
+      start[(keys[i] >> shift) & (AK_RADIX_SIZE - 1)]++;
+    int32_t sum = 0;
+    for (int d = 0; d < AK_RADIX_SIZE; d++) {
+      int32_t c = start[d];
+      start[d] = sum;
+      sum += c;
+    }
+    for (int i = 0; i < n; i++)
+      scratch[start[(keys[i] >> shift) & (AK_RADIX_SIZE - 1)]++] = keys[i];
+
+    uint32_t *t = keys;
+    keys = scratch;
+    scratch = t;
+  }
+  return keys;
+}
+
+// --- Batch kernels ---
+//
+// Each kernel walks one batch and writes a record for every pair, advancing
+// the output only on a hit. The output never runs ahead of the input, so a
+// buffer sized for the pairs always has room. Circle batches are split in
+// two passes: a cheap overlap filter over all pairs, then the normalize for the
+// survivors only.
+
+static int FilterCircles(const ak_world_t *world, const uint32_t *keys,
+                         int n, ak_contact_t *out) {
+  int count = 0;
+  int i = 0;
+
+#if defined(AK_SIMD_AVX2)
+  const ak_body_soa_t *soa = &world->soa;
+  const __m256i id_mask = _mm256_set1_epi32(AK_PAIR_ID_MASK);
+  const __m256i limit = _mm256_set1_epi32(8000000); // See ak_vec2_len_sqr
+  const __m256i max_sqr = _mm256_set1_epi32(2147483647);
+
+  for (; i + AK_SIMD_LANES <= n; i += AK_SIMD_LANES) {
+    __m256i k = _mm256_loadu_si256((const __m256i *)&keys[i]);
+    __m256i ia = _mm256_and_si256(_mm256_srli_epi32(k, AK_PAIR_ID_BITS),
+                                  id_mask);
+    __m256i ib = _mm256_and_si256(k, id_mask);
+
+    __m256i dx = _mm256_sub_epi32(_mm256_i32gather_epi32(soa->pos_x, ib, 4),
+                                  _mm256_i32gather_epi32(soa->pos_x, ia, 4));
+    __m256i dy = _mm256_sub_epi32(_mm256_i32gather_epi32(soa->pos_y, ib, 4),
+                                  _mm256_i32gather_epi32(soa->pos_y, ia, 4));
+    __m256i r = _mm256_add_epi32(_mm256_i32gather_epi32(soa->extent_x, ia, 4),
+                                 _mm256_i32gather_epi32(soa->extent_x, ib, 4));
+
+    __m256i dist_sqr =
+        _mm256_add_epi32(MulFixed8(dx, dx), MulFixed8(dy, dy));
+    __m256i far = _mm256_or_si256(
+        _mm256_cmpgt_epi32(_mm256_abs_epi32(dx), limit),
+        _mm256_cmpgt_epi32(_mm256_abs_epi32(dy), limit));
+    dist_sqr = _mm256_blendv_epi8(dist_sqr, max_sqr, far);
+
+    __m256i hit = _mm256_cmpgt_epi32(MulFixed8(r, r), dist_sqr);
+    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(hit));
+    if (!mask)
+      continue;
+
+    int32_t la[8], lb[8], lx[8], ly[8], ld[8];
+    _mm256_storeu_si256((__m256i *)la, ia);
+    _mm256_storeu_si256((__m256i *)lb, ib);
+    _mm256_storeu_si256((__m256i *)lx, dx);
+    _mm256_storeu_si256((__m256i *)ly, dy);
+    _mm256_storeu_si256((__m256i *)ld, dist_sqr);
+    for (int l = 0; l < AK_SIMD_LANES; l++) {
+      ak_contact_t *c = &out[count];
+      c->body_a_id = la[l];
+      c->body_b_id = lb[l];
+      c->normal.x = lx[l];
+      c->normal.y = ly[l];
+      c->depth = ld[l];
+      count += (mask >> l) & 1;
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    int a = AK_PAIR_KEY_A(keys[i]);
+    int b = AK_PAIR_KEY_B(keys[i]);
+    ak_vec2_t d =
+        ak_vec2_sub(ak_body_position(world, b), ak_body_position(world, a));
+    ak_fixed_t dist_sqr = ak_vec2_len_sqr(d);
+    ak_fixed_t r =
+        AK_FIXED_ADD(AK_BODY_RADIUS(world, a), AK_BODY_RADIUS(world, b));
+
+    ak_contact_t *c = &out[count];
+    c->body_a_id = a;
+    c->body_b_id = b;
+    c->normal = d;
+    c->depth = dist_sqr;
+    count += dist_sqr < AK_FIXED_MUL(r, r);
+  }
+  return count;
+}
+
+// Turns the offset and squared distance left by FilterCircles into a unit
+// normal and penetration depth.
+static void FinishCircles(const ak_world_t *world, ak_contact_t *c, int n) {
+  for (int i = 0; i < n; i++, c++) {
+    ak_fixed_t r = AK_FIXED_ADD(AK_BODY_RADIUS(world, c->body_a_id),
+                                AK_BODY_RADIUS(world, c->body_b_id));
+    ak_fixed_t dist_sqr = c->depth;
+    if (dist_sqr == 0) {
+      c->depth = r;
+      c->normal = (ak_vec2_t){AK_FIXED_ONE, 0};
+      continue;
+    }
+    ak_fixed_t dist;
+    c->normal = ak_vec2_normalize(c->normal, &dist);
+    c->depth = AK_FIXED_SUB(r, dist);
+  }
+}
+
+static int CollideCircles(const ak_world_t *world, const uint32_t *keys,
+                          int n, ak_contact_t *out) {
+  int count = FilterCircles(world, keys, n, out);
+  FinishCircles(world, out, count);
+  return count;
+}
+
+// Same two passes for circle-box pairs. The filter stores the offset from the
+// closest box point to the circle centre; the finish pass flips the normal
+// when the box is body A so it always points from A to B.
+static int CollideCircleBoxes(const ak_world_t *world, const uint32_t *keys,
+                              int n, ak_contact_t *out) {
+  int count = 0;
+  for (int i = 0; i < n; i++) {
+    int a = AK_PAIR_KEY_A(keys[i]);
+    int b = AK_PAIR_KEY_B(keys[i]);
+    int circle_first = AK_BODY_SHAPE_TYPE(world, a) == AK_SHAPE_CIRCLE;
+    int circle = circle_first ? a : b;
+    int box = circle_first ? b : a;
+
+    ak_vec2_t diff = ak_vec2_sub(ak_body_position(world, circle),
+                                 ak_body_position(world, box));
+    ak_fixed_t half_w = AK_BODY_HALF_W(world, box);
+    ak_fixed_t half_h = AK_BODY_HALF_H(world, box);
+    ak_vec2_t closest = {AK_FIXED_MAX(-half_w, AK_FIXED_MIN(half_w, diff.x)),
+                         AK_FIXED_MAX(-half_h, AK_FIXED_MIN(half_h, diff.y))};
+    ak_vec2_t d = ak_vec2_sub(diff, closest);
+    ak_fixed_t dist_sqr = ak_vec2_len_sqr(d);
+    ak_fixed_t r = AK_BODY_RADIUS(world, circle);
+
+    ak_contact_t *c = &out[count];
+    c->body_a_id = a;
+    c->body_b_id = b;
+    c->normal = d;
+    c->depth = dist_sqr;
+    count += dist_sqr <= AK_FIXED_MUL(r, r);
+  }
+
+  for (int i = 0; i < count; i++) {
+    ak_contact_t *c = &out[i];
+    int circle_first =
+        AK_BODY_SHAPE_TYPE(world, c->body_a_id) == AK_SHAPE_CIRCLE;
+    int circle = circle_first ? c->body_a_id : c->body_b_id;
+    int box = circle_first ? c->body_b_id : c->body_a_id;
+    ak_fixed_t r = AK_BODY_RADIUS(world, circle);
+    ak_fixed_t dist_sqr = c->depth;
+
+    if (dist_sqr == 0) {
+      // Centre inside the box: push out along the dominant axis, circle to box
+      ak_vec2_t diff = ak_vec2_sub(ak_body_position(world, circle),
+                                   ak_body_position(world, box));
+      if (AK_FIXED_ABS(diff.x) > AK_FIXED_ABS(diff.y))
+        c->normal = (ak_vec2_t){diff.x > 0 ? -AK_FIXED_ONE : AK_FIXED_ONE, 0};
+      else
+        c->normal = (ak_vec2_t){0, diff.y > 0 ? -AK_FIXED_ONE : AK_FIXED_ONE};
+      c->depth = r;
+    } else {
+      ak_fixed_t dist;
+      // d points box to circle; the circle-to-box normal is its negation
+      c->normal = ak_vec2_normalize(c->normal, &dist);
+      c->normal.x = -c->normal.x;
+      c->normal.y = -c->normal.y;
+      c->depth = AK_FIXED_SUB(r, dist);
+    }
+    if (!circle_first) {
+      c->normal.x = -c->normal.x;
+      c->normal.y = -c->normal.y;
+    }
+  }
+  return count;
+}
+
+// Box-box is cheap enough to finish in one branch-free pass.
+static int CollideBoxes(const ak_world_t *world, const uint32_t *keys, int n,
+                        ak_contact_t *out) {
+  int count = 0;
+  for (int i = 0; i < n; i++) {
+    int a = AK_PAIR_KEY_A(keys[i]);
+    int b = AK_PAIR_KEY_B(keys[i]);
+    ak_vec2_t d =
+        ak_vec2_sub(ak_body_position(world, b), ak_body_position(world, a));
+    ak_fixed_t x_overlap = AK_FIXED_SUB(
+        AK_FIXED_ADD(AK_BODY_HALF_W(world, a), AK_BODY_HALF_W(world, b)),
+        AK_FIXED_ABS(d.x));
+    ak_fixed_t y_overlap = AK_FIXED_SUB(
+        AK_FIXED_ADD(AK_BODY_HALF_H(world, a), AK_BODY_HALF_H(world, b)),
+        AK_FIXED_ABS(d.y));
+    int use_x = x_overlap < y_overlap;
+
+    ak_contact_t *c = &out[count];
+    c->body_a_id = a;
+    c->body_b_id = b;
+    c->normal.x = use_x ? (d.x < 0 ? -AK_FIXED_ONE : AK_FIXED_ONE) : 0;
+    c->normal.y = use_x ? 0 : (d.y < 0 ? -AK_FIXED_ONE : AK_FIXED_ONE);
+    c->depth = use_x ? x_overlap : y_overlap;
+    count += (x_overlap > 0) & (y_overlap > 0);
+  }
+  return count;
+}
+
+// First index in [begin, n) whose shape pair is past kind
+static int BatchEnd(const uint32_t *keys, int begin, int n, int kind) {
+  while (begin < n && AK_PAIR_KEY_KIND(keys[begin]) <= kind)
+    begin++;
+  return begin;
+}
+
+int ak_narrowphase_run(ak_world_t *world) {
+  int n = world->pair_count;
+  uint32_t *keys = SortPairs(world->pairs, world->pair_scratch, n);
+  ak_contact_t *out = world->contacts;
+  int count = 0;
+
+  int begin = 0;
+  int end = BatchEnd(keys, begin, n, AK_PAIR_CIRCLE_CIRCLE);
+  count += CollideCircles(world, keys + begin, end - begin, out + count);
+
+  begin = end;
+  end = BatchEnd(keys, begin, n, AK_PAIR_CIRCLE_AABB);
+  count += CollideCircleBoxes(world, keys + begin, end - begin, out + count);
+
+  begin = end;
+  count += CollideBoxes(world, keys + begin, n - begin, out + count);
+
+  world->stats.pair_tests += n;
+  world->stats.pair_hits += count;
+  world->pair_count = 0;
+  return count;
+}
@@ -0,0 +1,45 @@
+#ifndef AK_NARROWPHASE_H
+#define AK_NARROWPHASE_H
+
+#include "ak_physics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pair keys pack (shape pair << 30 | a << 15 | b). Sorting them groups each
+// shape pair into one contiguous batch, ordered by body ids, so the contact
+// order does not depend on which broadphase found the pairs.
+#define AK_PAIR_ID_BITS 15
+#define AK_PAIR_ID_MASK ((1u << AK_PAIR_ID_BITS) - 1)
+#define AK_PAIR_KIND_SHIFT (2 * AK_PAIR_ID_BITS)
+
+#define AK_PAIR_CIRCLE_CIRCLE 0
+#define AK_PAIR_CIRCLE_AABB 1 // Either body may be the circle
+#define AK_PAIR_AABB_AABB 2
+
+#define AK_PAIR_KEY(kind, a, b)                                               \
+  (((uint32_t)(kind) << AK_PAIR_KIND_SHIFT) |                                  \
+   ((uint32_t)(a) << AK_PAIR_ID_BITS) | (uint32_t)(b))
+#define AK_PAIR_KEY_A(k) ((int)(((k) >> AK_PAIR_ID_BITS) & AK_PAIR_ID_MASK))
+#define AK_PAIR_KEY_B(k) ((int)((k) & AK_PAIR_ID_MASK))
+#define AK_PAIR_KEY_KIND(k) ((int)((k) >> AK_PAIR_KIND_SHIFT))
+
+// Shape pair kind of two bodies
+#define AK_PAIR_KIND(w, a, b)                                                 \
+  ((int)AK_BODY_SHAPE_TYPE(w, a) + (int)AK_BODY_SHAPE_TYPE(w, b))
+
+// Queue the pair a < b. The caller flushes before world->pairs overflows.
+void ak_narrowphase_add_pair(ak_world_t *world, int a, int b);
+
+/**
+ * Collide every queued pair, one shape-pair batch at a time, into
+ * world->contacts. Returns the number of contacts written and leaves the
+ * pair buffer empty.
+ */
+int ak_narrowphase_run(ak_world_t *world);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AK_NARROWPHASE_H
@@ -1,6 +1,23 @@
 #include "ak_physics.h"
+#include "ak_broadphase.h"
+#ifdef AK_CHECKPOINTS
+#include "ak_checkpoint.h"
+#endif
+#include "ak_contact_cache.h"
+#ifdef AK_EVENTS
+#include "ak_events.h"
+#endif
+#include "ak_narrowphase.h"
+#include "ak_simd.h"
+#include "ak_threads.h"
 #include <stddef.h>
 
+#if defined(JAGUAR) && !defined(AK_SOA)
+// With -mshort, ak_body_t packs into 64 bytes, so DMA finds every body on a
+// 16-byte boundary. A new field needs room found, not padding.
+typedef char ak_body_stride_check[sizeof(ak_body_t) == 64 ? 1 : -1];
+#endif
+
 // --- Vector Math ---
 
 ak_vec2_t ak_vec2_add(ak_vec2_t a, ak_vec2_t b) {
@@ -33,357 +50,1261 @@ ak_fixed_t ak_vec2_len_sqr(ak_vec2_t v) {
 }
 
 // Safe length using 64-bit intermediates to support screen-width distances
-// dist_sqr for >181px overflows 32-bit fixed point.
+// dist_sqr for >181px overflows 32-bit fixed point. The 64-bit sum is the
+// squared length in 32.32, so its integer root is the 16.16 length.
 ak_fixed_t ak_vec2_len(ak_vec2_t v) {
   int64_t x = v.x;
   int64_t y = v.y;
-  int64_t sqr = (x * x) + (y * y); // 32.32 format essentially
+  return (ak_fixed_t)AK_FIXED_ISQRT64((uint64_t)(x * x + y * y));
+}
 
-  // Sqrt logic for 64-bit input to 16.16 output
-  // dist = sqrt(x^2 + y^2)
-  // We want result in 16.16.
-  // Input 'sqr' is effectively (value * 65536)^2.
-  // Sqrt(sqr) = value * 65536.
-  // So standard integer sqrt of the 64-bit sum gives the correct fixed-point
-  // representation directly.
+// One reciprocal square root gives both the length (sqr * rsqrt) and the unit
+// vector (v * rsqrt), with no square root loop and no divide.
+ak_vec2_t ak_vec2_normalize(ak_vec2_t v, ak_fixed_t *len) {
+  int64_t x = v.x;
+  int64_t y = v.y;
+  uint64_t sqr = (uint64_t)(x * x + y * y);
+  if (sqr == 0) {
+    *len = 0;
+    return v;
+  }
 
-  if (sqr <= 0)
-    return 0;
+  // sqr = m * 2^e with m in [2^30, 2^32), 1/|v| = r * 2^-(46 + e/2) in 32.32
+  int e;
+  int64_t r = AK_FIXED_RSQRT_MANT(sqr, &e);
+  uint64_t m = e >= 0 ? sqr >> e : sqr << -e;
+  int len_shift = 46 - e / 2;
+  int shift = 30 + e / 2;
+  int64_t half = (int64_t)1 << (shift - 1);
+  *len = (ak_fixed_t)((m * (uint64_t)r + ((uint64_t)1 << (len_shift - 1))) >>
+                      len_shift);
+  return (ak_vec2_t){(ak_fixed_t)((x * r + half) >> shift),
+                     (ak_fixed_t)((y * r + half) >> shift)};
+}
 
-  uint64_t root = 0;
-  uint64_t rem = (uint64_t)sqr;
-  uint64_t place = 1ULL << 62;
+ak_aabb_t ak_body_aabb(const ak_world_t *world, int i) {
+  ak_fixed_t hw, hh;
+  if (AK_BODY_SHAPE_TYPE(world, i) == AK_SHAPE_CIRCLE) {
+    hw = AK_BODY_RADIUS(world, i);
+    hh = hw;
+  } else {
+    hw = AK_BODY_HALF_W(world, i);
+    hh = AK_BODY_HALF_H(world, i);
+  }
+  ak_fixed_t x = AK_BODY_POS_X(world, i);
+  ak_fixed_t y = AK_BODY_POS_Y(world, i);
+  ak_aabb_t box = {{x - hw, y - hh}, {x + hw, y + hh}};
+  return box;
+}
 
-  while (place > rem)
-    place >>= 2;
+// --- State Hash ---
+// Each body's hash mixes its fields as 32-bit values seeded by its id, so
+// bodies cannot trade places unnoticed. The world hash is their sum, so a
+// body is rehashed by swapping its term and nothing else is touched.
 
-  while (place) {
-    if (rem >= root + place) {
-      rem -= root + place;
-      root += place * 2;
-    }
-    root >>= 1;
-    place >>= 2;
+#ifdef AK_HASH
+static uint32_t HashWord(uint32_t h, uint32_t v) {
+  h = (h ^ v) * (uint32_t)0x9E3779B1UL;
+  return h ^ (h >> 16);
+}
+
+static uint32_t BodyHash(const ak_world_t *world, int i) {
+  uint32_t h = HashWord((uint32_t)0x811C9DC5UL, (uint32_t)i);
+  h = HashWord(h, (uint32_t)AK_BODY_POS_X(world, i));
+  h = HashWord(h, (uint32_t)AK_BODY_POS_Y(world, i));
+  h = HashWord(h, (uint32_t)AK_BODY_VEL_X(world, i));
+  h = HashWord(h, (uint32_t)AK_BODY_VEL_Y(world, i));
+  return HashWord(h, (uint32_t)AK_BODY_SLEEP_TIME(world, i));
+}
+
+static void RehashBody(ak_world_t *world, int i) {
+  uint32_t h = BodyHash(world, i);
+  world->hash += h - world->body_hash[i];
+  world->body_hash[i] = h;
+}
+
+void ak_world_rehash_body(ak_world_t *world, ak_body_t *body) {
+  RehashBody(world, body->id);
+}
+
+void ak_world_rehash(ak_world_t *world) {
+  world->hash = 0;
+  for (int i = 0; i < world->body_count; i++) {
+    world->body_hash[i] = BodyHash(world, i);
+    world->hash += world->body_hash[i];
   }
+}
+
+#define REHASH_BODY(world, i) RehashBody(world, i)
+#else
+#define REHASH_BODY(world, i) ((void)0)
+#endif
+
+// --- Profiling ---
+// With AK_PROFILE, the clock time between two phase switches is charged to
+// the phase that was running. Without it the hooks compile away; counted
+// expressions are still evaluated.
+
+#ifdef AK_PROFILE
+void ak_world_set_profile_clock(ak_world_t *world, ak_clock_fn clock,
+                                void *user) {
+  world->profile_clock = clock;
+  world->profile_user = user;
+}
+
+static void ProfileBegin(ak_world_t *world, int phase) {
+  world->stats.impulses = 0;
+  world->stats.clamped = 0;
+  for (int p = 0; p < AK_PHASE_COUNT; p++)
+    world->stats.phase_ticks[p] = 0;
+  world->profile_phase = phase;
+  if (world->profile_clock)
+    world->profile_mark = world->profile_clock(world->profile_user);
+}
 
-  return (ak_fixed_t)root;
+static void ProfileSwitch(ak_world_t *world, int phase) {
+  if (world->profile_clock) {
+    uint32_t now = world->profile_clock(world->profile_user);
+    world->stats.phase_ticks[world->profile_phase] += now - world->profile_mark;
+    world->profile_mark = now;
+  }
+  world->profile_phase = phase;
 }
 
+#define PROFILE_SWITCH(world, phase) ProfileSwitch(world, phase)
+#define PROFILE_COUNT(counter, n) ((counter) += (n))
+#else
+#define PROFILE_SWITCH(world, phase) ((void)0)
+#define PROFILE_COUNT(counter, n) ((void)(n))
+#endif
+
 // -- World --
 
+// The world's arrays are laid out one after another in its arena, in the
+// order AK_WORLD_BYTES adds them up, each starting AK_ARENA_ALIGN aligned.
+#define AK_MAX_ARENA_BODIES 32767 // Pair keys hold 15-bit body ids
+#define AK_MAX_ARENA_ROWS 0xFFFFFL // Keeps the byte count in range
+
+static void *Carve(uint8_t **cursor, int32_t bytes) {
+  void *p = *cursor;
+  *cursor += (bytes + AK_ARENA_ALIGN - 1) & ~(int32_t)(AK_ARENA_ALIGN - 1);
+  return p;
+}
+
+#define CARVE(cursor, n, type)                                                 \
+  ((type *)Carve(cursor, (int32_t)(n) * (int32_t)sizeof(type)))
+
+// Fill in unset capacities. Returns 0 if any is out of range.
+static int ResolveCapacity(const ak_world_capacity_t *in,
+                           ak_world_capacity_t *out) {
+  *out = *in;
+  if (out->pairs == 0)
+    out->pairs = 2 * out->bodies;
+  if (out->cached_contacts == 0)
+    out->cached_contacts = out->pairs;
+  return out->bodies > 0 && out->bodies <= AK_MAX_ARENA_BODIES &&
+         out->tethers >= 0 && out->pairs > 0 && out->cached_contacts > 0 &&
+         out->tethers + out->pairs <= AK_MAX_ARENA_ROWS &&
+         out->cached_contacts <= AK_MAX_ARENA_ROWS;
+}
+
+int32_t ak_world_bytes(const ak_world_capacity_t *capacity) {
+  ak_world_capacity_t c;
+  if (!ResolveCapacity(capacity, &c))
+    return 0;
+  return AK_WORLD_BYTES(c.bodies, c.tethers, c.pairs, c.cached_contacts);
+}
+
+static void Layout(ak_world_t *world, const ak_world_capacity_t *c,
+                   uint8_t *cursor) {
+  int b = c->bodies;
+  int rows = c->pairs + c->tethers;
+
+  world->body_capacity = b;
+  world->tether_capacity = c->tethers;
+  world->pair_capacity = c->pairs;
+  world->bodies = CARVE(&cursor, b, ak_body_t);
+#ifdef AK_SOA
+  world->soa.pos_x = CARVE(&cursor, b, ak_fixed_t);
+  world->soa.pos_y = CARVE(&cursor, b, ak_fixed_t);
+  world->soa.vel_x = CARVE(&cursor, b, ak_fixed_t);
+  world->soa.vel_y = CARVE(&cursor, b, ak_fixed_t);
+  world->soa.force_x = CARVE(&cursor, b, ak_fixed_t);
+  world->soa.force_y = CARVE(&cursor, b, ak_fixed_t);
+  world->soa.mass = CARVE(&cursor, b, ak_fixed_t);
+  world->soa.inv_mass = CARVE(&cursor, b, ak_fixed_t);
+  world->soa.sleep_time = CARVE(&cursor, b, ak_fixed_t);
+  world->soa.extent_x = CARVE(&cursor, b, ak_fixed_t);
+  world->soa.extent_y = CARVE(&cursor, b, ak_fixed_t);
+  world->soa.shape_type = CARVE(&cursor, b, uint8_t);
+#endif
+#ifdef AK_HASH
+  world->body_hash = CARVE(&cursor, b, uint32_t);
+#endif
+  world->dynamic_bodies = CARVE(&cursor, b, int16_t);
+  world->handle_body = CARVE(&cursor, b, int16_t);
+  world->handle_generation = CARVE(&cursor, b, uint16_t);
+  world->statics.nodes = CARVE(&cursor, AK_STATIC_NODES(b), ak_static_node_t);
+  world->statics.order = CARVE(&cursor, b, int16_t);
+  world->tethers = CARVE(&cursor, c->tethers, ak_tether_t);
+  world->contacts = CARVE(&cursor, rows, ak_contact_t);
+  uint8_t *scratch = cursor; // See AK_ARENA_SCRATCH
+  world->pairs = CARVE(&scratch, c->pairs, uint32_t);
+  world->pair_scratch = CARVE(&scratch, c->pairs, uint32_t);
+  scratch = cursor;
+  world->islands = CARVE(&scratch, b, ak_island_t);
+  world->island_of = CARVE(&scratch, b, int16_t);
+  world->island_rows = CARVE(&scratch, rows, int);
+  cursor += AK_ARENA_SCRATCH(b, c->tethers, c->pairs);
+  world->contact_cache.capacity = c->cached_contacts;
+  world->contact_cache.entries[0] =
+      CARVE(&cursor, c->cached_contacts, ak_cached_contact_t);
+  world->contact_cache.entries[1] =
+      CARVE(&cursor, c->cached_contacts, ak_cached_contact_t);
+#if AK_BROADPHASE == AK_BROADPHASE_GRID
+  int32_t entries = (int32_t)b * AK_GRID_ENTRIES_PER_BODY;
+  world->grid.entry_body = CARVE(&cursor, entries, int16_t);
+  world->grid.entry_next = CARVE(&cursor, entries, int16_t);
+  world->grid.entry_capacity = entries < 32767 ? (int)entries : 32767;
+  world->grid.large = CARVE(&cursor, b, int16_t);
+  world->grid.min_col = CARVE(&cursor, b, int16_t);
+  world->grid.min_row = CARVE(&cursor, b, int16_t);
+#elif AK_BROADPHASE == AK_BROADPHASE_SAP
+  world->sap.endpoints = CARVE(&cursor, 2 * b, ak_sap_endpoint_t);
+  world->sap.min_y = CARVE(&cursor, b, ak_fixed_t);
+  world->sap.max_y = CARVE(&cursor, b, ak_fixed_t);
+  world->sap.active = CARVE(&cursor, b, int16_t);
+  world->sap.active_slot = CARVE(&cursor, b, int16_t);
+#elif AK_BROADPHASE == AK_BROADPHASE_TREE
+  world->tree.nodes = CARVE(&cursor, 2 * b, ak_tree_node_t);
+  world->tree.leaf = CARVE(&cursor, b, int32_t);
+#endif
+}
+
+int ak_world_init_arena(ak_world_t *world, ak_fixed_t width,
+                        ak_fixed_t height, ak_vec2_t gravity,
+                        const ak_world_capacity_t *capacity, void *memory,
+                        int32_t size) {
+  ak_world_capacity_t c;
+  if (!ResolveCapacity(capacity, &c) ||
+      size < AK_WORLD_BYTES(c.bodies, c.tethers, c.pairs, c.cached_contacts))
+    return 0;
+
+  uint8_t *base = (uint8_t *)memory;
+  base += (AK_ARENA_ALIGN - (uintptr_t)base % AK_ARENA_ALIGN) % AK_ARENA_ALIGN;
+  Layout(world, &c, base);
+  for (int i = 0; i < c.bodies; i++)
+    world->handle_generation[i] = 0;
+  ak_world_reset(world, width, height, gravity);
+  return 1;
+}
+
+#if AK_FIXED_STORAGE
 void ak_world_init(ak_world_t *world, ak_fixed_t width, ak_fixed_t height,
                    ak_vec2_t gravity) {
+  ak_world_capacity_t c = {AK_MAX_BODIES, AK_MAX_TETHERS, AK_MAX_PAIRS,
+                           AK_MAX_CACHED_CONTACTS};
+  ak_world_init_arena(world, width, height, gravity, &c, world->storage,
+                      (int32_t)sizeof(world->storage));
+}
+#endif
+
+void ak_world_reset(ak_world_t *world, ak_fixed_t width, ak_fixed_t height,
+                    ak_vec2_t gravity) {
   world->width = width;
   world->height = height;
   world->gravity = gravity;
   world->body_count = 0;
+  world->handle_count = 0;
+  world->handle_free = -1;
+  world->handle_limbo = -1;
+  world->tethers_stale = 0;
+  world->dynamic_count = 0;
+  world->statics.count = 0;
+  world->statics.node_count = 0;
+  world->statics.dirty = 0;
   world->tether_count = 0;
+  world->stats.pair_tests = 0;
+  world->stats.pair_hits = 0;
+  world->stats.batches = 0;
+  world->stats.islands = 0;
+  world->stats.iterations = 0;
+  world->stats.asleep = 0;
+  world->stats.pairs_culled = 0;
+  world->stats.nodes_culled = 0;
+  world->frame = 0;
+#ifdef AK_HASH
+  world->hash = 0;
+#endif
+#ifdef AK_CHECKPOINTS
+  world->checkpoints = NULL;
+#endif
+#ifdef AK_EVENTS
+  world->events = NULL;
+#endif
+  world->pair_count = 0;
+  world->contact_count = 0;
+  world->row_count = 0;
+  world->island_count = 0;
+#ifdef AK_PROFILE
+  world->profile_clock = NULL;
+  world->profile_user = NULL;
+  ProfileBegin(world, AK_PHASE_INTEGRATE);
+#endif
 
   // Scale constants relative to height (standard height 240)
   ak_fixed_t scale_y = AK_FIXED_DIV(height, AK_INT_TO_FIXED(240));
   world->slop = AK_FIXED_MUL(scale_y, AK_INT_TO_FIXED(1) / 100); // 0.01 scaled
   world->max_correction =
       AK_FIXED_MUL(scale_y, AK_INT_TO_FIXED(5)); // 5.0 scaled
+  world->bounce_threshold =
+      AK_FIXED_MUL(scale_y, AK_INT_TO_FIXED(12)); // 12 px/s
+  world->solver_iterations = AK_SOLVER_ITERATIONS;
+  world->solver_tolerance = AK_FIXED_MUL(scale_y, AK_FIXED_ONE / 100);
+  world->sleep_speed = AK_FIXED_MUL(scale_y, AK_INT_TO_FIXED(2)); // 2 px/s
+  world->sleep_delay = AK_FIXED_ONE / 2;                         // 0.5 s
+
+  ak_broadphase_init(world);
+  ak_contact_cache_init(world);
+}
+
+// --- Handles ---
+
+static ak_body_handle_t AllocHandle(ak_world_t *world, int index) {
+  int slot = world->handle_free;
+  if (slot >= 0) {
+    world->handle_free = world->handle_body[slot];
+  } else if (world->handle_count < world->body_capacity) {
+    slot = world->handle_count++;
+  } else {
+    // Only slots freed since the last step are left; the cache may still
+    // hold their old bodies' impulses
+    slot = world->handle_limbo;
+    world->handle_limbo = world->handle_body[slot];
+    ak_contact_cache_init(world);
+  }
+  uint16_t generation = (uint16_t)(world->handle_generation[slot] + 1);
+  if (generation == 0)
+    generation = 1;
+  world->handle_generation[slot] = generation;
+  world->handle_body[slot] = (int16_t)index;
+  return (ak_body_handle_t)generation << 16 | (ak_body_handle_t)slot;
+}
+
+static void FreeHandle(ak_world_t *world, int slot) {
+  if (world->handle_limbo < 0)
+    world->handle_limbo_tail = slot;
+  world->handle_body[slot] = (int16_t)world->handle_limbo;
+  world->handle_limbo = slot;
+}
+
+// End of step: no cached contact refers to the slots freed before it now
+static void ReleaseHandles(ak_world_t *world) {
+  if (world->handle_limbo < 0)
+    return;
+  world->handle_body[world->handle_limbo_tail] = (int16_t)world->handle_free;
+  world->handle_free = world->handle_limbo;
+  world->handle_limbo = -1;
+}
+
+int ak_world_body_index(const ak_world_t *world, ak_body_handle_t handle) {
+  int slot = AK_HANDLE_SLOT(handle);
+  if (slot >= world->handle_count)
+    return -1;
+  int i = world->handle_body[slot];
+  if (i < 0 || i >= world->body_count || world->bodies[i].handle != handle)
+    return -1;
+  return i;
+}
+
+ak_body_t *ak_world_get_body(ak_world_t *world, ak_body_handle_t handle) {
+  int i = ak_world_body_index(world, handle);
+  return i >= 0 ? &world->bodies[i] : NULL;
+}
+
+// --- Sleeping ---
+// A sleeping body keeps its slot in the broadphase but is not integrated,
+// and pairs between sleepers (or a sleeper and a static body) are skipped.
+// Anything that pushes on it wakes it: a contact or taut tether with an awake
+// body, a force, or a velocity written by the game. Its whole island wakes
+// with it, so a stack never has to be knocked awake body by body.
+
+static int Awake(const ak_world_t *world, int i) {
+  return !world->bodies[i].is_static && !ak_body_asleep(world, i);
+}
+
+// The next body of sleeping body i's ring (see AK_ASLEEP), or i itself if
+// the link does not name a sleeper, as from a damaged snapshot
+static int NextSleeper(const ak_world_t *world, int i) {
+  int32_t slot = AK_ASLEEP - AK_BODY_SLEEP_TIME(world, i);
+  int next = slot < world->handle_count ? world->handle_body[slot] : -1;
+  if (next < 0 || next >= world->body_count || !ak_body_asleep(world, next))
+    return i;
+  return next;
+}
+
+static void LinkSleeper(ak_world_t *world, int i, int next) {
+  AK_BODY_SLEEP_TIME(world, i) =
+      AK_ASLEEP - AK_HANDLE_SLOT(world->bodies[next].handle);
+  REHASH_BODY(world, i);
+}
+
+// Wakes body i and the rest of its ring, which ends where it started
+static void WakeIsland(ak_world_t *world, int i) {
+  while (ak_body_asleep(world, i)) {
+    int next = NextSleeper(world, i);
+    AK_BODY_SLEEP_TIME(world, i) = 0;
+    i = next;
+  }
+}
+
+// Called from the solver. Islands hold whole rings, so both bodies and every
+// sleeper woken with them are in the island being solved and this never
+// races with another thread.
+static void WakePair(ak_world_t *world, int a, int b) {
+  WakeIsland(world, a);
+  WakeIsland(world, b);
 }
 
+// --- Bodies ---
+
 ak_body_t *ak_world_add_body(ak_world_t *world, ak_shape_t shape, ak_fixed_t x,
                              ak_fixed_t y, ak_fixed_t mass) {
-  if (world->body_count >= AK_MAX_BODIES) {
+  if (world->body_count >= world->body_capacity) {
     return 0;
   }
-  ak_body_t *b = &world->bodies[world->body_count++];
-  b->position = (ak_vec2_t){x, y};
-  b->velocity = (ak_vec2_t){0, 0};
-  b->force = (ak_vec2_t){0, 0};
+  int index = world->body_count++;
+  ak_body_t *b = &world->bodies[index];
+  b->id = index;
+  AK_BODY_POS_X(world, index) = x;
+  AK_BODY_POS_Y(world, index) = y;
+  AK_BODY_VEL_X(world, index) = 0;
+  AK_BODY_VEL_Y(world, index) = 0;
+  AK_BODY_FORCE_X(world, index) = 0;
+  AK_BODY_FORCE_Y(world, index) = 0;
+  AK_BODY_SLEEP_TIME(world, index) = 0;
+#ifdef AK_SOA
+  world->soa.shape_type[index] = (uint8_t)shape.type;
+  if (shape.type == AK_SHAPE_CIRCLE) {
+    world->soa.extent_x[index] = shape.bounds.circle.radius;
+    world->soa.extent_y[index] = shape.bounds.circle.radius;
+  } else {
+    world->soa.extent_x[index] = shape.bounds.aabb.width;
+    world->soa.extent_y[index] = shape.bounds.aabb.height;
+  }
+#else
   b->shape = shape;
-  b->inv_mass = (mass > 0) ? AK_FIXED_DIV(AK_FIXED_ONE, mass) : 0;
+#endif
+  AK_BODY_MASS(world, index) = (mass > 0) ? mass : 0;
+  AK_BODY_INV_MASS(world, index) =
+      (mass > 0) ? AK_FIXED_DIV(AK_FIXED_ONE, mass) : 0;
   b->restitution = AK_FIXED_DIV(AK_INT_TO_FIXED(7), AK_INT_TO_FIXED(10)); // 0.7
   b->is_static = (mass == 0);
+  b->handle = AllocHandle(world, index);
+  b->category = AK_LAYER_DEFAULT;
+  b->mask = AK_LAYER_ALL;
+
+  if (b->is_static) {
+    b->list_index = world->statics.count;
+    world->statics.order[world->statics.count++] = (int16_t)index;
+    world->statics.dirty = 1;
+  } else {
+    b->list_index = world->dynamic_count;
+    world->dynamic_bodies[world->dynamic_count++] = (int16_t)index;
+    ak_broadphase_add(world, index);
+  }
+#ifdef AK_HASH
+  world->body_hash[index] = 0;
+  RehashBody(world, index);
+#endif
   return b;
 }
 
 void ak_world_add_tether(ak_world_t *world, ak_body_t *a, ak_body_t *b,
                          ak_fixed_t max_length) {
-  if (world->tether_count >= AK_MAX_TETHERS)
+  if (world->tether_count >= world->tether_capacity)
     return;
   ak_tether_t *t = &world->tethers[world->tether_count++];
-  t->a = a;
-  t->b = b;
-  t->max_length_sqr = AK_FIXED_MUL(max_length, max_length);
+  t->a = a->handle;
+  t->b = b->handle;
+  t->max_length = max_length;
 }
 
-static void ResolveTethers(ak_world_t *world) {
-  for (int i = 0; i < world->tether_count; i++) {
-    ak_tether_t *t = &world->tethers[i];
-    ak_vec2_t diff = ak_vec2_sub(t->b->position, t->a->position);
+// Swap-remove entry pos of a body list
+static void ListRemove(ak_world_t *world, int16_t *list, int *count,
+                       int pos) {
+  int moved = list[--*count];
+  list[pos] = (int16_t)moved;
+  world->bodies[moved].list_index = pos;
+}
 
-    // Optimization: Quick AABB rejection first
-    ak_fixed_t max_len = AK_FIXED_SQRT(t->max_length_sqr);
+// Moves body from into the free index to, for everything that indexes it
+static void MoveBody(ak_world_t *world, int from, int to) {
+  ak_body_t *b = &world->bodies[to];
+  *b = world->bodies[from];
+  b->id = to;
+#ifdef AK_SOA
+  ak_body_soa_t *soa = &world->soa;
+  soa->pos_x[to] = soa->pos_x[from];
+  soa->pos_y[to] = soa->pos_y[from];
+  soa->vel_x[to] = soa->vel_x[from];
+  soa->vel_y[to] = soa->vel_y[from];
+  soa->force_x[to] = soa->force_x[from];
+  soa->force_y[to] = soa->force_y[from];
+  soa->mass[to] = soa->mass[from];
+  soa->inv_mass[to] = soa->inv_mass[from];
+  soa->sleep_time[to] = soa->sleep_time[from];
+  soa->extent_x[to] = soa->extent_x[from];
+  soa->extent_y[to] = soa->extent_y[from];
+  soa->shape_type[to] = soa->shape_type[from];
+#endif
+  world->handle_body[AK_HANDLE_SLOT(b->handle)] = (int16_t)to;
+  if (b->is_static) {
+    world->statics.order[b->list_index] = (int16_t)to;
+  } else {
+    world->dynamic_bodies[b->list_index] = (int16_t)to;
+    ak_broadphase_move(world, from, to);
+  }
+#ifdef AK_HASH
+  // The hash is seeded with the index
+  world->body_hash[to] = world->body_hash[from];
+  RehashBody(world, to);
+#endif
+}
 
-    // Quick rejection: if either component > max_len, we are definitely outside
-    if (AK_FIXED_ABS(diff.x) <= max_len && AK_FIXED_ABS(diff.y) <= max_len) {
-      // Safe to use squared checks if we wanted, but sticking to safe length.
-    }
+// Tethers, the broadphase and the warm-start cache all refer to bodies by
+// handle or handle slot, so only the moved body's own entries change.
+// Tethers of the removed body are dropped by the next step.
+int ak_world_remove_body(ak_world_t *world, ak_body_handle_t handle) {
+  int i = ak_world_body_index(world, handle);
+  if (i < 0)
+    return 0;
 
-    // Calculate precise safe length (64-bit friendly)
-    ak_fixed_t dist = ak_vec2_len(diff);
+  // The rest of its island must not stay linked to the freed slot
+  WakeIsland(world, i);
+  ak_body_t *b = &world->bodies[i];
+  if (b->is_static) {
+    ListRemove(world, world->statics.order, &world->statics.count,
+               b->list_index);
+    world->statics.dirty = 1;
+  } else {
+    ak_broadphase_remove(world, i);
+    ListRemove(world, world->dynamic_bodies, &world->dynamic_count,
+               b->list_index);
+  }
+#ifdef AK_HASH
+  world->hash -= world->body_hash[i];
+#endif
+  FreeHandle(world, AK_HANDLE_SLOT(handle));
+  world->tethers_stale = world->tether_count > 0;
+
+  int last = --world->body_count;
+  if (i != last)
+    MoveBody(world, last, i);
+#ifdef AK_CHECKPOINTS
+  // The recorded frames no longer line up body for body
+  if (world->checkpoints)
+    world->checkpoints->replay_until = world->frame;
+#endif
+  return 1;
+}
 
-    if (dist <= max_len)
-      continue;
+int ak_world_add_bodies(ak_world_t *world, const ak_body_def_t *defs,
+                        int count, ak_body_handle_t *handles) {
+  int added = 0;
+  for (; added < count; added++) {
+    const ak_body_def_t *def = &defs[added];
+    ak_body_t *b =
+        ak_world_add_body(world, def->shape, def->x, def->y, def->mass);
+    if (!b)
+      break;
+    if (handles)
+      handles[added] = b->handle;
+  }
+  return added;
+}
 
-    ak_fixed_t excess = AK_FIXED_SUB(dist, max_len);
+int ak_world_remove_bodies(ak_world_t *world, const ak_body_handle_t *handles,
+                           int count) {
+  int removed = 0;
+  for (int k = 0; k < count; k++)
+    removed += ak_world_remove_body(world, handles[k]);
+  return removed;
+}
 
-    // Normalize diff to get direction: n = diff / dist
-    ak_vec2_t n = ak_vec2_mul(diff, AK_FIXED_DIV(AK_FIXED_ONE, dist));
+void ak_world_wake_body(ak_world_t *world, ak_body_t *body) {
+  if (!body->is_static) {
+    WakeIsland(world, body->id);
+    AK_BODY_SLEEP_TIME(world, body->id) = 0;
+  }
+}
 
-    // SOFT CONSTRAINT & STABILIZATION
-    const ak_fixed_t stiffness = AK_INT_TO_FIXED(5) / 10; // 0.5
-    ak_fixed_t correction_mag = AK_FIXED_MUL(excess, stiffness);
+void ak_world_set_collision_filter(ak_world_t *world, ak_body_t *body,
+                                   uint16_t category, uint16_t mask) {
+  body->category = category;
+  body->mask = mask;
+  if (body->is_static) {
+    world->statics.dirty = 1;
+  } else {
+    ak_broadphase_refilter(world, body->id);
+    ak_world_wake_body(world, body);
+  }
+}
 
-    // Clamp correction
-    ak_fixed_t max_corr = world->max_correction;
-    if (correction_mag > max_corr)
-      correction_mag = max_corr;
+void ak_world_apply_force(ak_world_t *world, ak_body_t *body, ak_vec2_t force) {
+  int i = body->id;
+  AK_BODY_FORCE_X(world, i) = AK_FIXED_ADD(AK_BODY_FORCE_X(world, i), force.x);
+  AK_BODY_FORCE_Y(world, i) = AK_FIXED_ADD(AK_BODY_FORCE_Y(world, i), force.y);
+  ak_world_wake_body(world, body);
+}
 
-    ak_vec2_t move = ak_vec2_mul(n, correction_mag);
+// --- Constraint Rows ---
+// Contacts and taut tethers are solved as the same row: an accumulated
+// impulse along the normal that may only push B away from A. A tether's
+// normal points from B back to A, so pushing B that way pulls the two
+// together.
+
+// Drops the tethers of removed bodies, keeping the rest in order
+static void DropDeadTethers(ak_world_t *world) {
+  int kept = 0;
+  for (int t = 0; t < world->tether_count; t++) {
+    const ak_tether_t *tether = &world->tethers[t];
+    if (ak_world_body_index(world, tether->a) >= 0 &&
+        ak_world_body_index(world, tether->b) >= 0)
+      world->tethers[kept++] = *tether;
+  }
+  world->tether_count = kept;
+  world->tethers_stale = 0;
+}
 
-    ak_fixed_t total_imass = AK_FIXED_ADD(t->a->inv_mass, t->b->inv_mass);
-    if (total_imass == 0)
+// Appends a row for every tether stretched past its length. Returns the new
+// row count.
+static int GatherTethers(ak_world_t *world, int count) {
+  for (int t = 0; t < world->tether_count; t++) {
+    const ak_tether_t *tether = &world->tethers[t];
+    int ia = world->handle_body[AK_HANDLE_SLOT(tether->a)];
+    int ib = world->handle_body[AK_HANDLE_SLOT(tether->b)];
+    if (!Awake(world, ia) && !Awake(world, ib))
       continue;
 
-    if (!t->a->is_static) {
-      ak_fixed_t share = AK_FIXED_DIV(t->a->inv_mass, total_imass);
-      t->a->position = ak_vec2_add(t->a->position, ak_vec2_mul(move, share));
-
-      ak_fixed_t vrel =
-          ak_vec2_dot(ak_vec2_sub(t->b->velocity, t->a->velocity), n);
-      if (vrel > 0) {
-        // Apply impulse to kill relative velocity
-        // P = vrel / total_imass (magnitude of impulse)
-        // dV = P * inv_mass * n
-        ak_vec2_t P = ak_vec2_mul(n, AK_FIXED_DIV(vrel, total_imass));
-        t->a->velocity =
-            ak_vec2_add(t->a->velocity, ak_vec2_mul(P, t->a->inv_mass));
-      }
-    }
-    if (!t->b->is_static) {
-      ak_fixed_t share = AK_FIXED_DIV(t->b->inv_mass, total_imass);
-      t->b->position = ak_vec2_sub(t->b->position, ak_vec2_mul(move, share));
-
-      ak_fixed_t vrel =
-          ak_vec2_dot(ak_vec2_sub(t->b->velocity, t->a->velocity), n);
-      if (vrel > 0) {
-        ak_vec2_t P = ak_vec2_mul(n, AK_FIXED_DIV(vrel, total_imass));
-        t->b->velocity =
-            ak_vec2_sub(t->b->velocity, ak_vec2_mul(P, t->b->inv_mass));
-      }
-    }
+    // Slack tethers are rejected on 64-bit squared lengths, before any root
+    ak_vec2_t diff =
+        ak_vec2_sub(ak_body_position(world, ia), ak_body_position(world, ib));
+    ak_fixed_t max_len = tether->max_length;
+    if ((int64_t)diff.x * diff.x + (int64_t)diff.y * diff.y <=
+        (int64_t)max_len * max_len)
+      continue;
+
+    ak_contact_t *row = &world->contacts[count++];
+    ak_fixed_t dist;
+    row->body_a_id = ia;
+    row->body_b_id = ib;
+    row->normal = ak_vec2_normalize(diff, &dist);
+    row->depth = AK_FIXED_SUB(dist, max_len);
+    row->normal_impulse = 0;
+    row->bounce = 0;
   }
+  return count;
 }
 
-// --- Collision ---
+static void ApplyImpulse(ak_world_t *world, const ak_contact_t *m,
+                         ak_fixed_t j) {
+  int ia = m->body_a_id;
+  int ib = m->body_b_id;
+  ak_vec2_t impulse = ak_vec2_mul(m->normal, j);
 
-typedef struct {
-  ak_body_t *a;
-  ak_body_t *b;
-  ak_vec2_t normal;
-  ak_fixed_t depth;
-  int has_collision;
-} ak_manifold_t;
+  if (!world->bodies[ia].is_static)
+    ak_body_set_velocity(world, ia,
+                         ak_vec2_sub(ak_body_velocity(world, ia),
+                                     ak_vec2_mul(impulse,
+                                                 AK_BODY_INV_MASS(world, ia))));
+  if (!world->bodies[ib].is_static)
+    ak_body_set_velocity(world, ib,
+                         ak_vec2_add(ak_body_velocity(world, ib),
+                                     ak_vec2_mul(impulse,
+                                                 AK_BODY_INV_MASS(world, ib))));
+  WakePair(world, ia, ib);
+}
 
-ak_manifold_t SolveCircleCircle(ak_body_t *a, ak_body_t *b) {
-  ak_manifold_t m = {a, b, {0, 0}, 0, 0};
-  ak_vec2_t n = ak_vec2_sub(b->position, a->position);
-  ak_fixed_t dist_sqr = ak_vec2_len_sqr(n);
-  ak_fixed_t r = AK_FIXED_ADD(a->shape.bounds.circle.radius,
-                              b->shape.bounds.circle.radius);
+// Effective mass of a row, so the passes below multiply instead of dividing.
+// Against a static body it is simply the other body's mass; 0 means neither
+// body can move.
+static ak_fixed_t RowMass(const ak_world_t *world, const ak_contact_t *m) {
+  ak_fixed_t ima = AK_BODY_INV_MASS(world, m->body_a_id);
+  ak_fixed_t imb = AK_BODY_INV_MASS(world, m->body_b_id);
+  if (ima == 0)
+    return imb == 0 ? 0 : AK_BODY_MASS(world, m->body_b_id);
+  if (imb == 0)
+    return AK_BODY_MASS(world, m->body_a_id);
+  return AK_FIXED_RECIP(AK_FIXED_ADD(ima, imb));
+}
 
-  if (dist_sqr >= AK_FIXED_MUL(r, r))
-    return m;
-  if (dist_sqr == 0) {
-    m.depth = r;
-    m.normal = (ak_vec2_t){AK_FIXED_ONE, 0};
-    m.has_collision = 1;
-    return m;
-  }
+// Restitution is judged on the approach speed before any impulse of this
+// step. Last step's impulse is then applied up front, so a resting contact
+// starts out already holding its bodies apart. Returns 1 if it applied one.
+static int WarmStart(ak_world_t *world, ak_contact_t *m) {
+  int ia = m->body_a_id;
+  int ib = m->body_b_id;
+  ak_vec2_t rv = ak_vec2_sub(ak_body_velocity(world, ib),
+                             ak_body_velocity(world, ia));
+  ak_fixed_t vel_along_normal = ak_vec2_dot(rv, m->normal);
 
-  ak_fixed_t dist = AK_FIXED_SQRT(dist_sqr);
-  m.depth = AK_FIXED_SUB(r, dist);
-  m.normal = ak_vec2_mul(n, AK_FIXED_DIV(AK_FIXED_ONE, dist));
-  m.has_collision = 1;
-  return m;
+  m->bounce = 0;
+  if (vel_along_normal < -world->bounce_threshold) {
+    ak_fixed_t e = AK_FIXED_MIN(world->bodies[ia].restitution,
+                                world->bodies[ib].restitution);
+    m->bounce = AK_FIXED_MUL(-e, vel_along_normal);
+  }
+  if (m->normal_impulse == 0)
+    return 0;
+  ApplyImpulse(world, m, m->normal_impulse);
+  return 1;
 }
 
-ak_manifold_t SolveAABBAABB(ak_body_t *a, ak_body_t *b) {
-  ak_manifold_t m = {a, b, {0, 0}, 0, 0};
-  ak_vec2_t n = ak_vec2_sub(b->position, a->position);
+// One velocity pass, driving the row's normal speed to zero. Returns how far
+// its impulse moved.
+static ak_fixed_t SolveRow(ak_world_t *world, ak_contact_t *m) {
+  int ia = m->body_a_id;
+  int ib = m->body_b_id;
+
+  if (m->mass == 0)
+    return 0;
+
+  ak_vec2_t rv = ak_vec2_sub(ak_body_velocity(world, ib),
+                             ak_body_velocity(world, ia));
+  ak_fixed_t vel_along_normal = ak_vec2_dot(rv, m->normal);
 
-  ak_fixed_t a_w = a->shape.bounds.aabb.width;
-  ak_fixed_t a_h = a->shape.bounds.aabb.height;
-  ak_fixed_t b_w = b->shape.bounds.aabb.width;
-  ak_fixed_t b_h = b->shape.bounds.aabb.height;
+  // Accumulate the impulse, clamping the total (not each pass of it) so
+  // rows only ever push
+  ak_fixed_t j = AK_FIXED_MUL(-vel_along_normal, m->mass);
+  ak_fixed_t total = AK_FIXED_MAX(AK_FIXED_ADD(m->normal_impulse, j), 0);
+  j = AK_FIXED_SUB(total, m->normal_impulse);
+  m->normal_impulse = total;
+  if (j != 0)
+    ApplyImpulse(world, m, j);
+  return AK_FIXED_ABS(j);
+}
 
-  ak_fixed_t x_overlap =
-      AK_FIXED_SUB(AK_FIXED_ADD(a_w, b_w), AK_FIXED_ABS(n.x));
-  if (x_overlap <= 0)
-    return m;
+// Restitution on top of the settled row. The extra impulse is not
+// accumulated, so the next step warm-starts from the resting load alone and
+// an impact is not fed back into the stack. Returns 1 if it applied one.
+static int BounceRow(ak_world_t *world, const ak_contact_t *m) {
+  if (m->mass == 0)
+    return 0;
 
-  ak_fixed_t y_overlap =
-      AK_FIXED_SUB(AK_FIXED_ADD(a_h, b_h), AK_FIXED_ABS(n.y));
-  if (y_overlap <= 0)
-    return m;
+  ak_vec2_t rv = ak_vec2_sub(ak_body_velocity(world, m->body_b_id),
+                             ak_body_velocity(world, m->body_a_id));
+  ak_fixed_t j = AK_FIXED_MUL(
+      AK_FIXED_SUB(m->bounce, ak_vec2_dot(rv, m->normal)), m->mass);
+  if (j <= 0)
+    return 0;
+  ApplyImpulse(world, m, j);
+  return 1;
+}
 
-  if (x_overlap < y_overlap) {
-    m.depth = x_overlap;
-    m.normal = (ak_vec2_t){n.x < 0 ? -AK_FIXED_ONE : AK_FIXED_ONE, 0};
+// Positional correction, once per row after the velocity passes. Contacts
+// push out a fraction of their penetration past the slop; tethers take back
+// half their stretch, clamped to max_correction. Returns 1 if it clamped.
+static int CorrectRow(ak_world_t *world, const ak_contact_t *m,
+                      int is_tether) {
+  int ia = m->body_a_id;
+  int ib = m->body_b_id;
+  ak_fixed_t ima = AK_BODY_INV_MASS(world, ia);
+  ak_fixed_t imb = AK_BODY_INV_MASS(world, ib);
+  int clamped = 0;
+
+  if (m->mass == 0)
+    return 0;
+
+  ak_fixed_t correction_mag;
+  if (is_tether) {
+    const ak_fixed_t stiffness = AK_INT_TO_FIXED(5) / 10; // 0.5
+    correction_mag = AK_FIXED_MUL(m->depth, stiffness);
+    if (correction_mag > world->max_correction) {
+      correction_mag = world->max_correction;
+      clamped = 1;
+    }
   } else {
-    m.depth = y_overlap;
-    m.normal = (ak_vec2_t){0, n.y < 0 ? -AK_FIXED_ONE : AK_FIXED_ONE};
+    const ak_fixed_t percent = AK_INT_TO_FIXED(2) / 10; // 0.2
+    correction_mag = AK_FIXED_MAX(AK_FIXED_SUB(m->depth, world->slop), 0);
+    correction_mag = AK_FIXED_MUL(correction_mag, percent);
   }
-  m.has_collision = 1;
-  return m;
+  if (correction_mag == 0)
+    return 0;
+  correction_mag = AK_FIXED_MUL(correction_mag, m->mass);
+  ak_vec2_t correction = ak_vec2_mul(m->normal, correction_mag);
+
+  if (!world->bodies[ia].is_static)
+    ak_body_set_position(world, ia,
+                         ak_vec2_sub(ak_body_position(world, ia),
+                                     ak_vec2_mul(correction, ima)));
+  if (!world->bodies[ib].is_static)
+    ak_body_set_position(world, ib,
+                         ak_vec2_add(ak_body_position(world, ib),
+                                     ak_vec2_mul(correction, imb)));
+  WakePair(world, ia, ib);
+  return clamped;
 }
 
-ak_manifold_t SolveCircleAABB(ak_body_t *circle, ak_body_t *aabb) {
-  ak_manifold_t m = {circle, aabb, {0, 0}, 0, 0};
+// --- Islands ---
+// Dynamic bodies joined by rows form an island. Static bodies never join
+// one, so islands share no state that the solver writes: solving them in any
+// order, or in parallel, gives bit-identical results.
+
+// Union-find over world->island_of. A root is always the lowest body id in
+// its set, so every parent index is below its child's.
+static int FindIsland(int16_t *parent, int i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
 
-  ak_vec2_t diff = ak_vec2_sub(circle->position, aabb->position);
-  ak_fixed_t half_w = aabb->shape.bounds.aabb.width;
-  ak_fixed_t half_h = aabb->shape.bounds.aabb.height;
-  ak_fixed_t clamped_x = AK_FIXED_MAX(-half_w, AK_FIXED_MIN(half_w, diff.x));
-  ak_fixed_t clamped_y = AK_FIXED_MAX(-half_h, AK_FIXED_MIN(half_h, diff.y));
+static void LinkBodies(ak_world_t *world, int a, int b) {
+  if (world->bodies[a].is_static || world->bodies[b].is_static)
+    return;
+  int ra = FindIsland(world->island_of, a);
+  int rb = FindIsland(world->island_of, b);
+  if (ra < rb)
+    world->island_of[rb] = (int16_t)ra;
+  else if (rb < ra)
+    world->island_of[ra] = (int16_t)rb;
+}
 
-  ak_vec2_t closest = {clamped_x, clamped_y};
-  ak_vec2_t n = ak_vec2_sub(diff, closest);
-  ak_fixed_t dist_sqr = ak_vec2_len_sqr(n);
-  ak_fixed_t r = circle->shape.bounds.circle.radius;
+static int IslandOf(const ak_world_t *world, const ak_contact_t *m) {
+  return world->bodies[m->body_a_id].is_static
+             ? world->island_of[m->body_b_id]
+             : world->island_of[m->body_a_id];
+}
 
-  if (dist_sqr > AK_FIXED_MUL(r, r))
-    return m;
+// Groups the current rows into islands. Rows keep their relative order
+// inside each island, so per body the solver sees the same sequence as a
+// serial pass. Each ring of sleepers is kept in one island, so a row that
+// wakes one of them can wake them all.
+static void BuildIslands(ak_world_t *world) {
+  int16_t *island_of = world->island_of;
 
-  m.has_collision = 1;
+  for (int i = 0; i < world->body_count; i++)
+    island_of[i] = (int16_t)i;
+  for (int i = 0; i < world->body_count; i++) {
+    if (ak_body_asleep(world, i))
+      LinkBodies(world, i, NextSleeper(world, i));
+  }
+  for (int r = 0; r < world->row_count; r++)
+    LinkBodies(world, world->contacts[r].body_a_id,
+               world->contacts[r].body_b_id);
 
-  if (dist_sqr == 0) {
-    if (AK_FIXED_ABS(diff.x) > AK_FIXED_ABS(diff.y)) {
-      m.depth = AK_FIXED_ADD(r, half_w);
-      // Normal from Circle to AABB (A->B)
-      // Diff is Circle - AABB. If diff.x > 0, Circle is to the Right. A->B
-      // should be Left (-1).
-      m.normal = (ak_vec2_t){diff.x > 0 ? -AK_FIXED_ONE : AK_FIXED_ONE, 0};
+  // Number the roots in id order. A parent is always visited before its
+  // children, so its slot already holds the island index when they read it.
+  int count = 0;
+  for (int i = 0; i < world->body_count; i++) {
+    if (world->bodies[i].is_static) {
+      island_of[i] = -1;
+    } else if (island_of[i] == i) {
+      world->islands[count].row_count = 0;
+      island_of[i] = (int16_t)count++;
     } else {
-      m.depth = AK_FIXED_ADD(r, half_h);
-      m.normal = (ak_vec2_t){0, diff.y > 0 ? -AK_FIXED_ONE : AK_FIXED_ONE};
+      island_of[i] = island_of[island_of[i]];
     }
-    m.depth = r;
-  } else {
-    ak_fixed_t dist = AK_FIXED_SQRT(dist_sqr);
-    m.depth = AK_FIXED_SUB(r, dist);
-    // n is Box->Circle. We want A->B (Circle->Box). So negate.
-    m.normal = ak_vec2_mul(n, -AK_FIXED_DIV(AK_FIXED_ONE, dist));
+  }
+  world->island_count = count;
+
+  // Count, then lay the ranges out back to back and fill them in order
+  for (int r = 0; r < world->row_count; r++)
+    world->islands[IslandOf(world, &world->contacts[r])].row_count++;
+
+  int first_row = 0;
+  for (int k = 0; k < count; k++) {
+    ak_island_t *island = &world->islands[k];
+    island->first_row = first_row;
+    first_row += island->row_count;
+    island->row_count = 0;
   }
 
-  return m;
+  for (int r = 0; r < world->row_count; r++) {
+    ak_island_t *island =
+        &world->islands[IslandOf(world, &world->contacts[r])];
+    world->island_rows[island->first_row + island->row_count++] = r;
+  }
 }
 
-static void ResolveCollision(ak_world_t *world, ak_manifold_t *m) {
-  if (!m->has_collision)
+static void SolveIsland(ak_world_t *world, int k) {
+  ak_island_t *island = &world->islands[k];
+  const int *rows = &world->island_rows[island->first_row];
+  int count = island->row_count;
+
+#ifdef AK_PROFILE
+  island->impulses = 0;
+  island->clamped = 0;
+#endif
+#ifdef AK_CHECKPOINTS
+  if (world->checkpoints && ak_checkpoint_replay_island(world, k)) {
+    island->iterations = 0;
     return;
+  }
+#endif
+  for (int i = 0; i < count; i++) {
+    ak_contact_t *m = &world->contacts[rows[i]];
+    m->mass = RowMass(world, m);
+    if (rows[i] < world->contact_count)
+      PROFILE_COUNT(island->impulses, WarmStart(world, m));
+  }
 
-  ak_vec2_t rv = ak_vec2_sub(m->b->velocity, m->a->velocity);
-  ak_fixed_t vel_along_normal = ak_vec2_dot(rv, m->normal);
+  // The passes settle every row as if it were perfectly inelastic;
+  // restitution is added once they are done.
+  int iterations = 0;
+  while (iterations < world->solver_iterations) {
+    ak_fixed_t largest = 0;
+    for (int i = 0; i < count; i++) {
+      ak_fixed_t change = SolveRow(world, &world->contacts[rows[i]]);
+      PROFILE_COUNT(island->impulses, change != 0);
+      if (change > largest)
+        largest = change;
+    }
+    iterations++;
+    if (largest <= world->solver_tolerance)
+      break;
+  }
+  island->iterations = (int16_t)iterations;
 
-  if (vel_along_normal > 0)
-    return;
+  for (int i = 0; i < count; i++) {
+    if (world->contacts[rows[i]].bounce != 0)
+      PROFILE_COUNT(island->impulses,
+                    BounceRow(world, &world->contacts[rows[i]]));
+  }
 
-  ak_fixed_t e = AK_FIXED_MIN(m->a->restitution, m->b->restitution);
-  ak_fixed_t j = AK_FIXED_MUL(-(AK_FIXED_ONE + e), vel_along_normal);
-  ak_fixed_t den = AK_FIXED_ADD(m->a->inv_mass, m->b->inv_mass);
+  for (int i = 0; i < count; i++)
+    PROFILE_COUNT(island->clamped,
+                  CorrectRow(world, &world->contacts[rows[i]],
+                             rows[i] >= world->contact_count));
+}
 
-  if (den == 0)
+static void RunIslands(ak_world_t *world) {
+#ifdef AK_THREADS
+  if (world->row_count >= AK_THREADS_MIN_CONTACTS &&
+      ak_threads_run(world, SolveIsland, world->island_count))
     return;
+#endif
+  for (int k = 0; k < world->island_count; k++)
+    SolveIsland(world, k);
+}
 
-  j = AK_FIXED_DIV(j, den);
+static void SolveIslands(ak_world_t *world, int last) {
+  BuildIslands(world);
+#ifdef AK_CHECKPOINTS
+  if (last && world->checkpoints)
+    ak_checkpoint_plan_replay(world);
+#else
+  (void)last;
+#endif
+  world->stats.islands += world->island_count;
+  RunIslands(world);
+
+  for (int k = 0; k < world->island_count; k++) {
+    if (world->islands[k].iterations > world->stats.iterations)
+      world->stats.iterations = world->islands[k].iterations;
+#ifdef AK_PROFILE
+    world->stats.impulses += world->islands[k].impulses;
+    world->stats.clamped += world->islands[k].clamped;
+#endif
+  }
+}
 
-  ak_vec2_t impulse = ak_vec2_mul(m->normal, j);
+// Collide the queued pairs and solve the contacts they produced. Tethers are
+// solved with the last batch of the step. Always runs inside the broadphase
+// phase, which it returns to.
+static void FlushPairs(ak_world_t *world, int last) {
+  world->stats.batches++;
+  PROFILE_SWITCH(world, AK_PHASE_NARROWPHASE);
+  world->contact_count = ak_narrowphase_run(world);
+  PROFILE_SWITCH(world, AK_PHASE_SOLVE);
+  world->row_count = world->contact_count;
+  if (last)
+    world->row_count = GatherTethers(world, world->row_count);
+  ak_contact_cache_fetch(world);
+  SolveIslands(world, last);
+  ak_contact_cache_store(world);
+#ifdef AK_EVENTS
+  if (world->events)
+    ak_events_record(world);
+#endif
+  PROFILE_SWITCH(world, AK_PHASE_BROADPHASE);
+}
 
-  if (!m->a->is_static)
-    m->a->velocity =
-        ak_vec2_sub(m->a->velocity, ak_vec2_mul(impulse, m->a->inv_mass));
-  if (!m->b->is_static)
-    m->b->velocity =
-        ak_vec2_add(m->b->velocity, ak_vec2_mul(impulse, m->b->inv_mass));
+static void CollectPair(ak_world_t *world, int a, int b) {
+  if (world->pair_count == world->pair_capacity)
+    FlushPairs(world, 0);
+  ak_narrowphase_add_pair(world, a, b);
+}
 
-  const ak_fixed_t percent = AK_INT_TO_FIXED(2) / 10; // 0.2
-  const ak_fixed_t slop = world->slop;
+// --- Integration ---
 
-  ak_fixed_t correction_mag = AK_FIXED_MAX(AK_FIXED_SUB(m->depth, slop), 0);
-  ak_fixed_t corr_num = AK_FIXED_MUL(correction_mag, percent);
-  correction_mag = AK_FIXED_DIV(corr_num, den);
-  ak_vec2_t correction = ak_vec2_mul(m->normal, correction_mag);
+static void IntegrateBody(ak_world_t *world, int i, ak_fixed_t dt) {
+  ak_fixed_t inv_mass = AK_BODY_INV_MASS(world, i);
+  ak_vec2_t force = {AK_BODY_FORCE_X(world, i), AK_BODY_FORCE_Y(world, i)};
 
-  if (!m->a->is_static)
-    m->a->position =
-        ak_vec2_sub(m->a->position, ak_vec2_mul(correction, m->a->inv_mass));
-  if (!m->b->is_static)
-    m->b->position =
-        ak_vec2_add(m->b->position, ak_vec2_mul(correction, m->b->inv_mass));
-}
+  // Apply gravity
+  force =
+      ak_vec2_add(force, ak_vec2_mul(world->gravity, AK_BODY_MASS(world, i)));
 
-void ak_world_step(ak_world_t *world, ak_fixed_t dt) {
-  for (int i = 0; i < world->body_count; i++) {
-    ak_body_t *b = &world->bodies[i];
-    if (b->is_static)
-      continue;
+  // Integrate Velocity
+  ak_vec2_t acceleration = ak_vec2_mul(force, inv_mass);
+  ak_vec2_t velocity =
+      ak_vec2_add(ak_body_velocity(world, i), ak_vec2_mul(acceleration, dt));
+  ak_body_set_velocity(world, i, velocity);
 
-    // Apply gravity
-    b->force = ak_vec2_add(
-        b->force,
-        ak_vec2_mul(world->gravity, AK_FIXED_DIV(AK_FIXED_ONE, b->inv_mass)));
+  // Integrate Position
+  ak_body_set_position(world, i, ak_vec2_add(ak_body_position(world, i),
+                                             ak_vec2_mul(velocity, dt)));
 
-    // Integrate Velocity
-    ak_vec2_t acceleration = ak_vec2_mul(b->force, b->inv_mass);
-    b->velocity = ak_vec2_add(b->velocity, ak_vec2_mul(acceleration, dt));
+  // Reset force
+  AK_BODY_FORCE_X(world, i) = 0;
+  AK_BODY_FORCE_Y(world, i) = 0;
+}
 
-    // Integrate Position
-    b->position = ak_vec2_add(b->position, ak_vec2_mul(b->velocity, dt));
+#if defined(AK_SIMD_AVX2)
+// Integrates bodies [0, count) in blocks of 8; static (inv_mass == 0) and
+// sleeping bodies are masked out and left untouched, like the scalar loop
+// skips them.
+static int IntegrateSimd(ak_world_t *world, int count, ak_fixed_t dt) {
+  ak_body_soa_t *soa = &world->soa;
+  const __m256i vdt = _mm256_set1_epi32(dt);
+  const __m256i gx = _mm256_set1_epi32(world->gravity.x);
+  const __m256i gy = _mm256_set1_epi32(world->gravity.y);
+  const __m256i zero = _mm256_setzero_si256();
+  int i = 0;
+
+  for (; i + AK_SIMD_LANES <= count; i += AK_SIMD_LANES) {
+    __m256i im = _mm256_loadu_si256((const __m256i *)&soa->inv_mass[i]);
+    __m256i m = _mm256_loadu_si256((const __m256i *)&soa->mass[i]);
+    __m256i sleep = _mm256_loadu_si256((const __m256i *)&soa->sleep_time[i]);
+    __m256i fixed = _mm256_or_si256(_mm256_cmpeq_epi32(im, zero),
+                                    _mm256_cmpgt_epi32(zero, sleep));
+
+    __m256i old_fx = _mm256_loadu_si256((const __m256i *)&soa->force_x[i]);
+    __m256i vx = _mm256_loadu_si256((const __m256i *)&soa->vel_x[i]);
+    __m256i px = _mm256_loadu_si256((const __m256i *)&soa->pos_x[i]);
+    __m256i fx = _mm256_add_epi32(old_fx, MulFixed8(gx, m));
+    __m256i nvx = _mm256_add_epi32(vx, MulFixed8(MulFixed8(fx, im), vdt));
+    __m256i npx = _mm256_add_epi32(px, MulFixed8(nvx, vdt));
+
+    __m256i old_fy = _mm256_loadu_si256((const __m256i *)&soa->force_y[i]);
+    __m256i vy = _mm256_loadu_si256((const __m256i *)&soa->vel_y[i]);
+    __m256i py = _mm256_loadu_si256((const __m256i *)&soa->pos_y[i]);
+    __m256i fy = _mm256_add_epi32(old_fy, MulFixed8(gy, m));
+    __m256i nvy = _mm256_add_epi32(vy, MulFixed8(MulFixed8(fy, im), vdt));
+    __m256i npy = _mm256_add_epi32(py, MulFixed8(nvy, vdt));
+
+    _mm256_storeu_si256((__m256i *)&soa->vel_x[i],
+                        _mm256_blendv_epi8(nvx, vx, fixed));
+    _mm256_storeu_si256((__m256i *)&soa->vel_y[i],
+                        _mm256_blendv_epi8(nvy, vy, fixed));
+    _mm256_storeu_si256((__m256i *)&soa->pos_x[i],
+                        _mm256_blendv_epi8(npx, px, fixed));
+    _mm256_storeu_si256((__m256i *)&soa->pos_y[i],
+                        _mm256_blendv_epi8(npy, py, fixed));
+    _mm256_storeu_si256((__m256i *)&soa->force_x[i],
+                        _mm256_and_si256(old_fx, fixed));
+    _mm256_storeu_si256((__m256i *)&soa->force_y[i],
+                        _mm256_and_si256(old_fy, fixed));
+  }
+  return i;
+}
+#elif defined(AK_SIMD_SSE2)
+// Integrates bodies [0, count) in blocks of 4; static (inv_mass == 0) and
+// sleeping bodies are masked out and left untouched, like the scalar loop
+// skips them.
+static int IntegrateSimd(ak_world_t *world, int count, ak_fixed_t dt) {
+  ak_body_soa_t *soa = &world->soa;
+  const __m128i vdt = _mm_set1_epi32(dt);
+  const __m128i gx = _mm_set1_epi32(world->gravity.x);
+  const __m128i gy = _mm_set1_epi32(world->gravity.y);
+  const __m128i zero = _mm_setzero_si128();
+  int i = 0;
+
+  for (; i + AK_SIMD_LANES <= count; i += AK_SIMD_LANES) {
+    __m128i im = _mm_loadu_si128((const __m128i *)&soa->inv_mass[i]);
+    __m128i m = _mm_loadu_si128((const __m128i *)&soa->mass[i]);
+    __m128i sleep = _mm_loadu_si128((const __m128i *)&soa->sleep_time[i]);
+    __m128i fixed = _mm_or_si128(_mm_cmpeq_epi32(im, zero),
+                                 _mm_cmplt_epi32(sleep, zero));
+
+    __m128i old_fx = _mm_loadu_si128((const __m128i *)&soa->force_x[i]);
+    __m128i vx = _mm_loadu_si128((const __m128i *)&soa->vel_x[i]);
+    __m128i px = _mm_loadu_si128((const __m128i *)&soa->pos_x[i]);
+    __m128i fx = _mm_add_epi32(old_fx, MulFixed4(gx, m));
+    __m128i nvx = _mm_add_epi32(vx, MulFixed4(MulFixed4(fx, im), vdt));
+    __m128i npx = _mm_add_epi32(px, MulFixed4(nvx, vdt));
+
+    __m128i old_fy = _mm_loadu_si128((const __m128i *)&soa->force_y[i]);
+    __m128i vy = _mm_loadu_si128((const __m128i *)&soa->vel_y[i]);
+    __m128i py = _mm_loadu_si128((const __m128i *)&soa->pos_y[i]);
+    __m128i fy = _mm_add_epi32(old_fy, MulFixed4(gy, m));
+    __m128i nvy = _mm_add_epi32(vy, MulFixed4(MulFixed4(fy, im), vdt));
+    __m128i npy = _mm_add_epi32(py, MulFixed4(nvy, vdt));
+
+    _mm_storeu_si128((__m128i *)&soa->vel_x[i], Select4(fixed, vx, nvx));
+    _mm_storeu_si128((__m128i *)&soa->vel_y[i], Select4(fixed, vy, nvy));
+    _mm_storeu_si128((__m128i *)&soa->pos_x[i], Select4(fixed, px, npx));
+    _mm_storeu_si128((__m128i *)&soa->pos_y[i], Select4(fixed, py, npy));
+    _mm_storeu_si128((__m128i *)&soa->force_x[i],
+                     _mm_and_si128(old_fx, fixed));
+    _mm_storeu_si128((__m128i *)&soa->force_y[i],
+                     _mm_and_si128(old_fy, fixed));
+  }
+  return i;
+}
+#endif
+
+static void Integrate(ak_world_t *world, ak_fixed_t dt) {
+  // Sleepers that were given a force or velocity since the last step wake up
+  for (int k = 0; k < world->dynamic_count; k++) {
+    int i = world->dynamic_bodies[k];
+    if (ak_body_asleep(world, i) &&
+        (AK_BODY_FORCE_X(world, i) | AK_BODY_FORCE_Y(world, i) |
+         AK_BODY_VEL_X(world, i) | AK_BODY_VEL_Y(world, i)))
+      WakeIsland(world, i);
+  }
 
-    // Reset force
-    b->force = (ak_vec2_t){0, 0};
+#ifdef AK_SIMD_LANES
+  // The kernel covers whole blocks of the body array; the scalar path
+  // finishes the tail.
+  int done = IntegrateSimd(world, world->body_count, dt);
+  for (int i = done; i < world->body_count; i++) {
+    if (Awake(world, i))
+      IntegrateBody(world, i, dt);
+  }
+#else
+  for (int k = 0; k < world->dynamic_count; k++) {
+    int i = world->dynamic_bodies[k];
+    if (!ak_body_asleep(world, i))
+      IntegrateBody(world, i, dt);
   }
+#endif
+}
 
-  // Collisions
-  for (int i = 0; i < world->body_count; i++) {
-    for (int j = i + 1; j < world->body_count; j++) {
-      ak_manifold_t m = {0};
-      ak_body_t *a = &world->bodies[i];
-      ak_body_t *b = &world->bodies[j];
+// Advances each awake body's rest timer and puts islands to sleep once all
+// of their bodies have rested for sleep_delay. Islands come from the last
+// batch of the step, which holds every contact unless the pair buffer
+// overflowed. Each island that falls asleep is linked into one ring, taking
+// in any rings already asleep in it. With AK_HASH, also rehashes every body
+// the step moved.
+static void UpdateSleep(ak_world_t *world, ak_fixed_t dt) {
+  ak_fixed_t delay = world->sleep_delay;
+  int32_t asleep = 0;
+
+  if (delay > 0) {
+    ak_fixed_t speed_sqr = AK_FIXED_MUL(world->sleep_speed, world->sleep_speed);
+    // The solve is done with the row ranges, so they hold the first and
+    // last body of each ring being linked instead
+    for (int k = 0; k < world->island_count; k++) {
+      world->islands[k].can_sleep = 0;
+      world->islands[k].first_row = -1;
+    }
 
-      if (a->is_static && b->is_static)
+    for (int k = 0; k < world->dynamic_count; k++) {
+      int i = world->dynamic_bodies[k];
+      if (ak_body_asleep(world, i))
         continue;
+      if (ak_vec2_len_sqr(ak_body_velocity(world, i)) > speed_sqr)
+        AK_BODY_SLEEP_TIME(world, i) = 0;
+      else if (AK_BODY_SLEEP_TIME(world, i) < delay)
+        AK_BODY_SLEEP_TIME(world, i) += dt;
+      ak_island_t *island = &world->islands[world->island_of[i]];
+      if (AK_BODY_SLEEP_TIME(world, i) < delay)
+        island->can_sleep = -1;
+      else if (island->can_sleep == 0)
+        island->can_sleep = 1;
+    }
 
-      if (a->shape.type == AK_SHAPE_CIRCLE &&
-          b->shape.type == AK_SHAPE_CIRCLE) {
-        m = SolveCircleCircle(a, b);
-      } else if (a->shape.type == AK_SHAPE_AABB &&
-                 b->shape.type == AK_SHAPE_AABB) {
-        m = SolveAABBAABB(a, b);
-      } else if (a->shape.type == AK_SHAPE_CIRCLE &&
-                 b->shape.type == AK_SHAPE_AABB) {
-        m = SolveCircleAABB(a, b);
-      } else if (a->shape.type == AK_SHAPE_AABB &&
-                 b->shape.type == AK_SHAPE_CIRCLE) {
-        m = SolveCircleAABB(b, a);
-        m.normal = ak_vec2_mul(m.normal, -AK_FIXED_ONE);
-        m.a = a;
-        m.b = b;
-      }
-
-      if (m.has_collision) {
-        ResolveCollision(world, &m);
-      }
+    for (int k = 0; k < world->dynamic_count; k++) {
+      int i = world->dynamic_bodies[k];
+      ak_island_t *island = &world->islands[world->island_of[i]];
+      if (island->can_sleep != 1)
+        continue;
+      ak_body_set_velocity(world, i, (ak_vec2_t){0, 0});
+      if (island->first_row < 0)
+        island->first_row = i;
+      else
+        LinkSleeper(world, island->row_count, i);
+      island->row_count = i;
+    }
+    for (int k = 0; k < world->island_count; k++) {
+      const ak_island_t *island = &world->islands[k];
+      if (island->first_row >= 0)
+        LinkSleeper(world, island->row_count, island->first_row);
     }
   }
 
-  // Tethers
-  ResolveTethers(world);
+  // Sleepers were rehashed when they were linked and not touched since, so
+  // only awake bodies need it
+  for (int k = 0; k < world->dynamic_count; k++) {
+    int i = world->dynamic_bodies[k];
+    if (ak_body_asleep(world, i))
+      asleep++;
+    else
+      REHASH_BODY(world, i);
+  }
+  world->stats.asleep = asleep;
+}
+
+void ak_world_step(ak_world_t *world, ak_fixed_t dt) {
+  if (world->statics.dirty)
+    ak_broadphase_bake_static(world);
+  world->stats.pair_tests = 0;
+  world->stats.pair_hits = 0;
+  world->stats.batches = 0;
+  world->stats.islands = 0;
+  world->stats.iterations = 0;
+  world->stats.pairs_culled = 0;
+  world->stats.nodes_culled = 0;
+#ifdef AK_PROFILE
+  ProfileBegin(world, AK_PHASE_INTEGRATE);
+#endif
+
+  if (world->tethers_stale)
+    DropDeadTethers(world);
+  Integrate(world, dt);
+
+  // Collisions and tethers
+#ifdef AK_EVENTS
+  if (world->events)
+    ak_events_begin_step(world);
+#endif
+  PROFILE_SWITCH(world, AK_PHASE_BROADPHASE);
+  ak_broadphase_find_pairs(world, CollectPair);
+  FlushPairs(world, 1);
+  PROFILE_SWITCH(world, AK_PHASE_SOLVE);
+  ak_contact_cache_commit(world);
+#ifdef AK_EVENTS
+  if (world->events)
+    ak_events_end_step(world);
+#endif
+  ReleaseHandles(world);
+
+  PROFILE_SWITCH(world, AK_PHASE_SLEEP);
+  UpdateSleep(world, dt);
+  world->frame++;
+
+#ifdef AK_CHECKPOINTS
+  if (world->checkpoints) {
+    PROFILE_SWITCH(world, AK_PHASE_CHECKPOINT);
+    ak_checkpoint_end_step(world);
+  }
+#endif
+  PROFILE_SWITCH(world, AK_PHASE_SLEEP); // Charge the last phase
+}
+
+void ak_world_step_n(ak_world_t *world, ak_fixed_t dt, int n,
+                     ak_input_fn input, void *user) {
+  for (int s = 0; s < n; s++) {
+    if (input)
+      input(world, world->frame + 1, user);
+    ak_world_step(world, dt);
+  }
+}
+
+void ak_world_bake_static(ak_world_t *world) {
+  ak_broadphase_bake_static(world);
 }
@@ -3,6 +3,8 @@
 
 #include "ak_fixed.h"
 
+// Capacities of a world set up with ak_world_init. Worlds given their own
+// memory with ak_world_init_arena pick their capacities at run time.
 #ifndef AK_MAX_BODIES
 #define AK_MAX_BODIES 64
 #endif
@@ -11,6 +13,106 @@
 #define AK_MAX_TETHERS 16
 #endif
 
+// Static bodies are baked into an immutable BVH with up to this many bodies
+// per leaf. Leaves of a split tree hold at least half this many, so a tree
+// has one leaf or at most 2 * bodies / AK_STATIC_LEAF_SIZE.
+#ifndef AK_STATIC_LEAF_SIZE
+#define AK_STATIC_LEAF_SIZE 4
+#endif
+#define AK_STATIC_NODES(bodies)                                                \
+  (2 * (bodies) < AK_STATIC_LEAF_SIZE ? 1                                      \
+                                      : 4 * (bodies) / AK_STATIC_LEAF_SIZE - 1)
+
+#ifndef AK_STATIC_STACK_SIZE
+#define AK_STATIC_STACK_SIZE 32
+#endif
+
+// Candidate pairs buffered per narrow phase batch. A full buffer is flushed
+// (collided and resolved) early, so this trades RAM for batch size only.
+#ifndef AK_MAX_PAIRS
+#define AK_MAX_PAIRS (AK_MAX_BODIES * 2)
+#endif
+
+// Contacts whose accumulated impulse is carried over to the next step for
+// warm starting. Contacts past this in a step simply start cold.
+#ifndef AK_MAX_CACHED_CONTACTS
+#define AK_MAX_CACHED_CONTACTS AK_MAX_PAIRS
+#endif
+
+// Velocity passes over each island's constraint rows, the default for
+// world->solver_iterations. An island stops early once a pass changes no
+// impulse by more than world->solver_tolerance.
+#ifndef AK_SOLVER_ITERATIONS
+#define AK_SOLVER_ITERATIONS 8
+#endif
+
+// Batched queries walk the broadphase this many at a time (at most 32, one
+// bit each). Each cast in flight costs 64 bytes of stack.
+#ifndef AK_QUERY_PACKET
+#define AK_QUERY_PACKET 16
+#endif
+#if AK_QUERY_PACKET < 1 || AK_QUERY_PACKET > 32
+#error "AK_QUERY_PACKET must be between 1 and 32"
+#endif
+
+// Broadphase selection (compile time). The brute-force loop tests every pair
+// and needs no extra RAM, so it stays the default for small scenes.
+#define AK_BROADPHASE_NONE 0 // O(n^2) pair loop
+#define AK_BROADPHASE_GRID 1 // Uniform grid, rebuilt every step
+#define AK_BROADPHASE_SAP 2  // Persistent sort-and-sweep on the x axis
+#define AK_BROADPHASE_TREE 3 // Dynamic AABB tree with fattened leaves
+
+#ifndef AK_BROADPHASE
+#define AK_BROADPHASE AK_BROADPHASE_NONE
+#endif
+
+#if AK_BROADPHASE == AK_BROADPHASE_TREE
+// Leaves are enlarged by this many pixels (scaled like slop) so that small
+// movements do not require re-inserting the body.
+#ifndef AK_TREE_MARGIN
+#define AK_TREE_MARGIN 2
+#endif
+
+// Traversal stack depth. The tree is height-balanced, so 64 covers far more
+// bodies than a world can hold.
+#ifndef AK_TREE_STACK_SIZE
+#define AK_TREE_STACK_SIZE 64
+#endif
+
+// Bodies added between steps go into the tree as one subtree when their
+// combined bounds cover at most this many times the area of their own
+// (fattened) bounds, as a burst of debris does; scattered spawns are
+// inserted one by one.
+#ifndef AK_TREE_BURST_SPREAD
+#define AK_TREE_BURST_SPREAD 4
+#endif
+#endif
+
+#if AK_BROADPHASE == AK_BROADPHASE_GRID
+// Cell size is a power of two (in whole pixels) so binning is a shift, not a
+// 64-bit divide. It grows automatically if the world needs more than
+// AK_GRID_MAX_CELLS cells.
+#ifndef AK_GRID_CELL_SHIFT
+#define AK_GRID_CELL_SHIFT 5 // 32px cells
+#endif
+
+#ifndef AK_GRID_MAX_CELLS
+#define AK_GRID_MAX_CELLS 128
+#endif
+
+// Body-in-cell links per body of capacity. When the pool runs dry the
+// remaining bodies fall back to the "large" list, which stays correct but is
+// tested against everyone.
+#ifndef AK_GRID_ENTRIES_PER_BODY
+#define AK_GRID_ENTRIES_PER_BODY 4
+#endif
+
+// Bodies covering more cells than this (e.g. the ground) go on the large list.
+#ifndef AK_GRID_LARGE_CELLS
+#define AK_GRID_LARGE_CELLS 8
+#endif
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -19,6 +121,10 @@ typedef struct {
   ak_fixed_t x, y;
 } ak_vec2_t;
 
+typedef struct {
+  ak_vec2_t min, max;
+} ak_aabb_t;
+
 typedef enum { AK_SHAPE_CIRCLE, AK_SHAPE_AABB } ak_shape_type_t;
 
 typedef struct {
@@ -33,45 +139,482 @@ typedef struct {
   } bounds;
 } ak_shape_t;
 
+// Bodies are kept dense in world->bodies, so removing one moves the last body
+// into its place and ak_body_t pointers and ids only hold until the next
+// removal. A handle names a body for as long as it exists: the low 16 bits
+// pick a slot in the world's handle table and the high 16 bits count how
+// often that slot has been reused, so a handle to a removed body never finds
+// its successor. 0 is never a handle.
+typedef uint32_t ak_body_handle_t;
+
+#define AK_NULL_HANDLE 0
+#define AK_HANDLE_SLOT(h) ((int)((h) & 0xFFFFu))
+
+// With AK_SOA defined, the fields touched every step (position, velocity,
+// force, mass, inverse mass, shape and sleep timer) move out of ak_body_t
+// into contiguous arrays in world->soa. Use the AK_BODY_* accessors below to
+// reach them in either layout.
 typedef struct {
-  int id;
+  int id; // Index in world->bodies
+#ifndef AK_SOA
   ak_vec2_t position;
   ak_vec2_t velocity;
   ak_vec2_t force;
-  ak_fixed_t mass;
-  ak_fixed_t inv_mass;    // 0 for static
-  ak_fixed_t restitution; // Bounciness
+  ak_fixed_t mass;     // 0 for static
+  ak_fixed_t inv_mass; // 0 for static
   ak_shape_t shape;
-  int is_static;
-#ifdef JAGUAR
-  int32_t padding[2]; // Pad to 64 bytes for 16-byte alignment (DMA friendly)
+  ak_fixed_t sleep_time; // Seconds at rest, below 0 once asleep (AK_ASLEEP)
 #endif
+  ak_fixed_t restitution; // Bounciness
+  int is_static;
+  ak_body_handle_t handle;
+  int list_index; // Position in world->dynamic_bodies or statics.order
+  // Collision filter, set with ak_world_set_collision_filter
+  uint16_t category; // Layer bits the body is in
+  uint16_t mask;     // Layer bits it collides with
 } ak_body_t;
 
+// Filter of a new body: in the first layer, colliding with every layer
+#define AK_LAYER_DEFAULT 0x0001
+#define AK_LAYER_ALL 0xFFFF
+
+// One body for ak_world_add_bodies, as ak_world_add_body takes it
+typedef struct {
+  ak_shape_t shape;
+  ak_fixed_t x, y;
+  ak_fixed_t mass; // 0 for a static body
+} ak_body_def_t;
+
+// A sleeping body's timer is AK_ASLEEP - s, linking it to the body with
+// handle slot s: the next of the island it fell asleep with, the last linking
+// back to the first. Following the ring from any sleeper wakes the island.
+#define AK_ASLEEP (-1)
+
+#ifdef AK_SOA
+// One array per field, each body_capacity long
+typedef struct {
+  ak_fixed_t *pos_x;
+  ak_fixed_t *pos_y;
+  ak_fixed_t *vel_x;
+  ak_fixed_t *vel_y;
+  ak_fixed_t *force_x;
+  ak_fixed_t *force_y;
+  ak_fixed_t *mass;
+  ak_fixed_t *inv_mass;
+  ak_fixed_t *sleep_time;
+  // Circles store their radius in both extents
+  ak_fixed_t *extent_x; // Radius or half-width
+  ak_fixed_t *extent_y; // Radius or half-height
+  uint8_t *shape_type;
+} ak_body_soa_t;
+#endif
+
 typedef struct {
-  ak_body_t *a;
-  ak_body_t *b;
-  ak_fixed_t max_length_sqr;
+  ak_body_handle_t a;
+  ak_body_handle_t b;
+  ak_fixed_t max_length;
 } ak_tether_t;
 
+// Narrow phase output, always with body_a_id < body_b_id. The solver fills
+// in the impulse fields. A taut tether is solved as the same kind of row,
+// with its normal pointing from B back to A and its stretch as the depth.
 typedef struct {
   int body_a_id;
   int body_b_id;
-  ak_vec2_t normal;
+  ak_vec2_t normal; // Unit normal from A to B
+  ak_fixed_t depth;
+  ak_fixed_t normal_impulse; // Accumulated this step, warm-started
+  ak_fixed_t bounce;         // Separating speed asked for by restitution
+  ak_fixed_t mass; // 1 / (inv_mass_a + inv_mass_b), set once per step
 } ak_contact_t;
 
+typedef struct {
+  uint32_t key; // Pair key of the bodies' handle slots, which survive removals
+  ak_fixed_t normal_impulse;
+} ak_cached_contact_t;
+
+// Double-buffered: entries[front] holds last step's contacts sorted by key,
+// the other buffer collects this step's.
+typedef struct {
+  ak_cached_contact_t *entries[2]; // capacity entries each
+  int capacity;
+  int count[2];
+  int front;
+  int sorted; // This step's entries were recorded in key order
+} ak_contact_cache_t;
+
+#ifdef AK_PROFILE
+// Phases of ak_world_step timed into stats.phase_ticks. Pairs collided and
+// solved early because the pair buffer filled count toward the narrow phase
+// and solve, not the broadphase that triggered them.
+#define AK_PHASE_INTEGRATE 0   // Forces, velocities and positions
+#define AK_PHASE_BROADPHASE 1  // Pair finding
+#define AK_PHASE_NARROWPHASE 2 // Shape tests into contact records
+#define AK_PHASE_SOLVE 3       // Islands, tethers and the contact cache
+#define AK_PHASE_SLEEP 4       // Rest timers and the state hash
+#define AK_PHASE_CHECKPOINT 5  // Recording and replay (AK_CHECKPOINTS)
+#define AK_PHASE_COUNT 6
+
+// Monotonic tick source for profiling, in whatever unit the platform has
+// (cycles, microseconds, ...). Wrapping is fine: only differences are used.
+typedef uint32_t (*ak_clock_fn)(void *user);
+#endif
+
+// Per-step counters, reset at the start of every ak_world_step.
+typedef struct {
+  int32_t pair_tests; // Pairs handed to the narrow phase
+  int32_t pair_hits;  // Pairs that produced a contact
+  int32_t batches;    // Narrow phase batches, 1 unless the pair buffer filled
+  int32_t islands;    // Islands solved
+  int32_t iterations; // Most velocity passes any island needed
+  int32_t asleep;     // Dynamic bodies asleep after the step
+  // Broadphase candidates the collision filters rejected: single pairs, or
+  // whole tree and static BVH nodes whose bodies the filter rules out
+  int32_t pairs_culled;
+  int32_t nodes_culled;
+#ifdef AK_PROFILE
+  int32_t impulses; // Nonzero impulses applied, warm starts included
+  int32_t clamped;  // Tether corrections cut to world->max_correction
+  uint32_t phase_ticks[AK_PHASE_COUNT]; // Clock ticks spent per phase
+#endif
+} ak_world_stats_t;
+
+// Dynamic bodies linked by contacts or taut tethers. The range indexes
+// world->island_rows.
+typedef struct {
+  int first_row;
+  int row_count;
+  int16_t iterations; // Velocity passes run on the last solve
+  int16_t can_sleep;  // 1 if it fell asleep on the last step
+#ifdef AK_PROFILE
+  // Kept per island so threads never share a counter
+  int32_t impulses;
+  int32_t clamped;
+#endif
+} ak_island_t;
+
+typedef struct {
+  ak_aabb_t box;
+  int16_t first; // Leaf: first slot in order[]. Inner: right child node
+  int16_t count; // Leaf: number of bodies. 0 for inner nodes
+  // Union of the filters of the bodies below, to prune whole subtrees
+  uint16_t category, mask;
+} ak_static_node_t;
+
+// Static bodies never move, so they are kept out of the broadphase and baked
+// once into a median-split BVH. An inner node's left child is the node that
+// immediately follows it.
+typedef struct {
+  ak_static_node_t *nodes; // AK_STATIC_NODES(body_capacity)
+  int node_count;
+  int16_t *order; // Static body indices, grouped by leaf
+  int count;
+  int dirty; // A static body was added since the last bake
+} ak_static_set_t;
+
+#if AK_BROADPHASE == AK_BROADPHASE_TREE
+// Node indices are 32-bit: a pool of 2 nodes per body outgrows int16_t past
+// 16383 bodies, and arena worlds go up to 32767.
+typedef struct {
+  ak_aabb_t box;          // Fattened for leaves
+  int32_t parent;         // Next free node while on the free list
+  int32_t child1, child2; // -1 for leaves
+  int16_t height;         // 0 for leaves, -1 when free
+  int16_t body;           // Leaves only
+  uint16_t category, mask; // Union of the filters of the leaves below
+} ak_tree_node_t;
+
+typedef struct {
+  ak_tree_node_t *nodes; // 2 per body of capacity
+  int32_t root;
+  int32_t free_list;
+  int32_t *leaf;   // Leaf node of each body
+  int32_t pending; // Leaves added since the last update, chained both ways
+  ak_fixed_t margin;
+} ak_tree_t;
+#endif
+
+#if AK_BROADPHASE == AK_BROADPHASE_SAP
+typedef struct {
+  ak_fixed_t value; // Cached x of the body's min or max edge
+  ak_body_handle_t handle;
+  int16_t body; // Index of handle's body, refreshed after removals
+  int16_t is_max;
+} ak_sap_endpoint_t;
+
+// Endpoints stay sorted between steps, so the per-step insertion sort only
+// pays for bodies that actually swapped places. Bodies added since the last
+// update wait past sorted_count and are merged in as one batch.
+typedef struct {
+  ak_sap_endpoint_t *endpoints; // 2 per body of capacity
+  int endpoint_count;
+  int sorted_count; // Endpoints placed by the last update
+  int moved;        // Bodies were removed since the last update
+  ak_fixed_t *min_y;
+  ak_fixed_t *max_y;
+  int16_t *active;      // Bodies open during the sweep
+  int16_t *active_slot; // Index of each body in active[]
+} ak_sap_t;
+#endif
+
+#if AK_BROADPHASE == AK_BROADPHASE_GRID
+typedef struct {
+  int cell_shift; // Cell size = 1 << cell_shift pixels
+  int cols, rows;
+  int16_t cell_head[AK_GRID_MAX_CELLS];
+  int entry_capacity;
+  int16_t *entry_body;
+  int16_t *entry_next;
+  int16_t *large;
+  int large_count;
+  // First cell covered by each body, used to report a pair only once
+  int16_t *min_col;
+  int16_t *min_row;
+} ak_grid_t;
+#endif
+
+// Capacities of one world
+typedef struct {
+  int32_t bodies;
+  int32_t tethers;
+  int32_t pairs;           // Narrow phase batch; 0 for 2 per body
+  int32_t cached_contacts; // Warm-start cache; 0 for one per pair
+} ak_world_capacity_t;
+
+// Every array in a world's arena starts on this boundary: the pointer size,
+// which covers every field type, or 16 with AK_SIMD for vector loads. 8-bit
+// targets, which have no alignment rules, can save the padding with 1.
+#ifndef AK_ARENA_ALIGN
+#ifdef AK_SIMD
+#define AK_ARENA_ALIGN 16
+#else
+#define AK_ARENA_ALIGN ((int32_t)sizeof(void *))
+#endif
+#endif
+
+// Arena bytes for one array of n elements, rounded up so the next one stays
+// aligned
+#define AK_ARENA_ARRAY(n, type)                                                \
+  (((int32_t)(n) * (int32_t)sizeof(type) + AK_ARENA_ALIGN - 1) &               \
+   ~(int32_t)(AK_ARENA_ALIGN - 1))
+
+#ifdef AK_SOA
+#define AK_ARENA_SOA(b)                                                        \
+  (11 * AK_ARENA_ARRAY(b, ak_fixed_t) + AK_ARENA_ARRAY(b, uint8_t))
+#else
+#define AK_ARENA_SOA(b) 0
+#endif
+#ifdef AK_HASH
+#define AK_ARENA_HASH(b) AK_ARENA_ARRAY(b, uint32_t)
+#else
+#define AK_ARENA_HASH(b) 0
+#endif
+#if AK_BROADPHASE == AK_BROADPHASE_GRID
+#define AK_ARENA_BROADPHASE(b)                                                 \
+  (2 * AK_ARENA_ARRAY((b) * AK_GRID_ENTRIES_PER_BODY, int16_t) +               \
+   3 * AK_ARENA_ARRAY(b, int16_t))
+#elif AK_BROADPHASE == AK_BROADPHASE_SAP
+#define AK_ARENA_BROADPHASE(b)                                                 \
+  (AK_ARENA_ARRAY(2 * (b), ak_sap_endpoint_t) +                                \
+   2 * AK_ARENA_ARRAY(b, ak_fixed_t) + 2 * AK_ARENA_ARRAY(b, int16_t))
+#elif AK_BROADPHASE == AK_BROADPHASE_TREE
+#define AK_ARENA_BROADPHASE(b)                                                 \
+  (AK_ARENA_ARRAY(2 * (b), ak_tree_node_t) + AK_ARENA_ARRAY(b, int32_t))
+#else
+#define AK_ARENA_BROADPHASE(b) 0
+#endif
+
+// The pair queue and its sort buffer are idle from the time a batch has
+// been collided until the broadphase queues the next pair. Islands are
+// built, solved and put to sleep in that window, so their arrays, the row
+// lists included, share the same bytes.
+#define AK_ARENA_PAIRS(p) (2 * AK_ARENA_ARRAY(p, uint32_t))
+#define AK_ARENA_ISLANDS(b, rows)                                              \
+  (AK_ARENA_ARRAY(b, ak_island_t) + AK_ARENA_ARRAY(b, int16_t) +               \
+   AK_ARENA_ARRAY(rows, int))
+#define AK_ARENA_SCRATCH(b, t, p)                                              \
+  (AK_ARENA_PAIRS(p) > AK_ARENA_ISLANDS(b, (p) + (t))                          \
+       ? AK_ARENA_PAIRS(p)                                                     \
+       : AK_ARENA_ISLANDS(b, (p) + (t)))
+
+// Bytes ak_world_init_arena needs for b bodies, t tethers, p pairs and c
+// cached contacts (all resolved, none 0), slack for aligning the block
+// included. ak_world_bytes evaluates it for a capacity struct.
+#define AK_WORLD_BYTES(b, t, p, c)                                             \
+  (AK_ARENA_ALIGN - 1 + AK_ARENA_ARRAY(b, ak_body_t) + AK_ARENA_SOA(b) +       \
+   AK_ARENA_HASH(b) + AK_ARENA_ARRAY(b, int16_t) /* dynamic_bodies */ +        \
+   AK_ARENA_ARRAY(b, int16_t) + AK_ARENA_ARRAY(b, uint16_t) /* handles */ +    \
+   AK_ARENA_ARRAY(AK_STATIC_NODES(b), ak_static_node_t) +                      \
+   AK_ARENA_ARRAY(b, int16_t) /* statics.order */ +                            \
+   AK_ARENA_ARRAY(t, ak_tether_t) + AK_ARENA_ARRAY((p) + (t), ak_contact_t) +  \
+   AK_ARENA_SCRATCH(b, t, p) + 2 * AK_ARENA_ARRAY(c, ak_cached_contact_t) +    \
+   AK_ARENA_BROADPHASE(b))
+
+// Worlds set up with ak_world_init carry storage for the AK_MAX_* capacities.
+// Define AK_FIXED_STORAGE as 0 in builds that only use ak_world_init_arena,
+// so that ak_world_t shrinks to its header.
+#ifndef AK_FIXED_STORAGE
+#define AK_FIXED_STORAGE 1
+#endif
+
 typedef struct {
   ak_fixed_t width;
   ak_fixed_t height;
   ak_fixed_t slop;
   ak_fixed_t max_correction;
+  ak_fixed_t bounce_threshold; // Slower impacts do not bounce
+  int solver_iterations;
+  ak_fixed_t solver_tolerance; // Impulse change that counts as converged
+  // Bodies slower than sleep_speed for sleep_delay seconds fall asleep once
+  // their whole island has. A sleep_delay of 0 disables sleeping.
+  ak_fixed_t sleep_speed;
+  ak_fixed_t sleep_delay;
   ak_vec2_t gravity;
-  ak_body_t bodies[AK_MAX_BODIES];
+  int32_t frame; // Steps taken since ak_world_init
+#ifdef AK_CHECKPOINTS
+  struct ak_checkpoint_ring *checkpoints; // See ak_checkpoint.h
+#endif
+#ifdef AK_EVENTS
+  struct ak_event_ring *events; // See ak_events.h
+#endif
+#ifdef AK_HASH
+  // State hash for desync checks: the sum of body_hash over every body,
+  // each a hash of that body's position, velocity and rest timer.
+  uint32_t hash;
+  uint32_t *body_hash;
+#endif
+  // Every array below is carved out of the world's arena at init, sized by
+  // these capacities
+  int body_capacity;
+  int tether_capacity;
+  int pair_capacity;
+  ak_body_t *bodies;
+#ifdef AK_SOA
+  ak_body_soa_t soa;
+#endif
   int body_count;
-  ak_tether_t tethers[AK_MAX_TETHERS];
+  // Handle table, one slot per body of capacity. A live slot holds its
+  // body's index and a free one the next free slot. Slots freed since the
+  // last step wait on their own list, so warm-start entries keyed by a
+  // removed body's slot have expired before a new body can take it.
+  int16_t *handle_body;
+  uint16_t *handle_generation;
+  int handle_count; // Slots handed out at least once
+  int handle_free;  // -1 when empty
+  int handle_limbo; // Freed since the last step
+  int handle_limbo_tail;
+  int tethers_stale; // A removed body may have left tethers behind
+  int16_t *dynamic_bodies; // Indices of non-static bodies
+  int dynamic_count;
+  ak_static_set_t statics;
+  ak_tether_t *tethers;
   int tether_count;
+  ak_world_stats_t stats;
+#ifdef AK_PROFILE
+  ak_clock_fn profile_clock; // NULL leaves phase_ticks at zero
+  void *profile_user;
+  uint32_t profile_mark; // Clock at the last phase switch
+  int profile_phase;     // Phase being charged
+#endif
+  // Narrow phase scratch. Pairs are packed keys (see ak_narrowphase.h);
+  // contacts hold the rows of the last batch solved: contact_count contacts,
+  // then its tether rows up to row_count.
+  uint32_t *pairs;
+  uint32_t *pair_scratch; // Radix sort buffer
+  int pair_count;
+  // A batch solves its contacts plus, on the last batch, one row per taut
+  // tether
+  ak_contact_t *contacts; // pair_capacity + tether_capacity rows
+  int contact_count;
+  int row_count;
+  // Islands of the last batch, ordered by their lowest body id. island_of
+  // maps a body to its island (-1 for static bodies). These arrays overlay
+  // the pair queue, so they only hold from the last batch of a step to the
+  // next step's broadphase.
+  ak_island_t *islands;
+  int island_count;
+  int16_t *island_of;
+  int *island_rows;
+  ak_contact_cache_t contact_cache;
+#if AK_BROADPHASE == AK_BROADPHASE_GRID
+  ak_grid_t grid;
+#elif AK_BROADPHASE == AK_BROADPHASE_SAP
+  ak_sap_t sap;
+#elif AK_BROADPHASE == AK_BROADPHASE_TREE
+  ak_tree_t tree;
+#endif
+#if AK_FIXED_STORAGE
+  uint32_t storage[(AK_WORLD_BYTES(AK_MAX_BODIES, AK_MAX_TETHERS,
+                                   AK_MAX_PAIRS, AK_MAX_CACHED_CONTACTS) +
+                    3) / 4];
+#endif
 } ak_world_t;
 
+// Body field accessors (lvalues), indexed by body id
+#ifdef AK_SOA
+#define AK_BODY_POS_X(w, i) ((w)->soa.pos_x[i])
+#define AK_BODY_POS_Y(w, i) ((w)->soa.pos_y[i])
+#define AK_BODY_VEL_X(w, i) ((w)->soa.vel_x[i])
+#define AK_BODY_VEL_Y(w, i) ((w)->soa.vel_y[i])
+#define AK_BODY_FORCE_X(w, i) ((w)->soa.force_x[i])
+#define AK_BODY_FORCE_Y(w, i) ((w)->soa.force_y[i])
+#define AK_BODY_MASS(w, i) ((w)->soa.mass[i])
+#define AK_BODY_INV_MASS(w, i) ((w)->soa.inv_mass[i])
+#define AK_BODY_SLEEP_TIME(w, i) ((w)->soa.sleep_time[i])
+#define AK_BODY_SHAPE_TYPE(w, i) ((ak_shape_type_t)(w)->soa.shape_type[i])
+#define AK_BODY_RADIUS(w, i) ((w)->soa.extent_x[i])
+#define AK_BODY_HALF_W(w, i) ((w)->soa.extent_x[i])
+#define AK_BODY_HALF_H(w, i) ((w)->soa.extent_y[i])
+#else
+#define AK_BODY_POS_X(w, i) ((w)->bodies[i].position.x)
+#define AK_BODY_POS_Y(w, i) ((w)->bodies[i].position.y)
+#define AK_BODY_VEL_X(w, i) ((w)->bodies[i].velocity.x)
+#define AK_BODY_VEL_Y(w, i) ((w)->bodies[i].velocity.y)
+#define AK_BODY_FORCE_X(w, i) ((w)->bodies[i].force.x)
+#define AK_BODY_FORCE_Y(w, i) ((w)->bodies[i].force.y)
+#define AK_BODY_MASS(w, i) ((w)->bodies[i].mass)
+#define AK_BODY_INV_MASS(w, i) ((w)->bodies[i].inv_mass)
+#define AK_BODY_SLEEP_TIME(w, i) ((w)->bodies[i].sleep_time)
+#define AK_BODY_SHAPE_TYPE(w, i) ((w)->bodies[i].shape.type)
+#define AK_BODY_RADIUS(w, i) ((w)->bodies[i].shape.bounds.circle.radius)
+#define AK_BODY_HALF_W(w, i) ((w)->bodies[i].shape.bounds.aabb.width)
+#define AK_BODY_HALF_H(w, i) ((w)->bodies[i].shape.bounds.aabb.height)
+#endif
+
+static inline ak_vec2_t ak_body_position(const ak_world_t *w, int i) {
+  ak_vec2_t v;
+  v.x = AK_BODY_POS_X(w, i);
+  v.y = AK_BODY_POS_Y(w, i);
+  return v;
+}
+
+static inline void ak_body_set_position(ak_world_t *w, int i, ak_vec2_t v) {
+  AK_BODY_POS_X(w, i) = v.x;
+  AK_BODY_POS_Y(w, i) = v.y;
+}
+
+static inline ak_vec2_t ak_body_velocity(const ak_world_t *w, int i) {
+  ak_vec2_t v;
+  v.x = AK_BODY_VEL_X(w, i);
+  v.y = AK_BODY_VEL_Y(w, i);
+  return v;
+}
+
+static inline void ak_body_set_velocity(ak_world_t *w, int i, ak_vec2_t v) {
+  AK_BODY_VEL_X(w, i) = v.x;
+  AK_BODY_VEL_Y(w, i) = v.y;
+}
+
+// Static bodies are never asleep
+static inline int ak_body_asleep(const ak_world_t *w, int i) {
+  return AK_BODY_SLEEP_TIME(w, i) < 0;
+}
+
+// Each body's category must be in the other's mask
+static inline int ak_bodies_collide(const ak_body_t *a, const ak_body_t *b) {
+  return (a->category & b->mask) && (b->category & a->mask);
+}
+
 // Vector Math
 ak_vec2_t ak_vec2_add(ak_vec2_t a, ak_vec2_t b);
 ak_vec2_t ak_vec2_sub(ak_vec2_t a, ak_vec2_t b);
@@ -79,22 +622,208 @@ ak_vec2_t ak_vec2_mul(ak_vec2_t v, ak_fixed_t s);
 ak_fixed_t ak_vec2_dot(ak_vec2_t a, ak_vec2_t b);
 ak_fixed_t ak_vec2_len_sqr(ak_vec2_t v);
 ak_fixed_t ak_vec2_len(ak_vec2_t v);
+// Unit vector along v, with |v| stored in *len. A zero v is returned as is
+// with *len = 0. See ak_fixed.h for the accuracy.
+ak_vec2_t ak_vec2_normalize(ak_vec2_t v, ak_fixed_t *len);
+
+// Tight bounds of body i at its current position
+ak_aabb_t ak_body_aabb(const ak_world_t *world, int i);
+
+#ifdef AK_THREADS
+// Solve islands on `count` threads, the stepping thread included; 1 stops the
+// worker pool. The pool is shared by all worlds, so only call this between
+// steps. Returns the number of threads now in use.
+int ak_set_thread_count(int count);
+#endif
 
 // Physics API
+#if AK_FIXED_STORAGE
+// Set up world with the AK_MAX_* capacities, in its own storage
 void ak_world_init(ak_world_t *world, ak_fixed_t width, ak_fixed_t height,
                    ak_vec2_t gravity);
+#endif
+
+// Bytes of arena a world with these capacities needs
+int32_t ak_world_bytes(const ak_world_capacity_t *capacity);
+
+/**
+ * Set up world with its arrays in the caller's memory block (any alignment,
+ * at least ak_world_bytes(capacity) bytes), which must outlive it. Nothing is
+ * allocated. Returns 0 if the block is too small or a capacity is out of
+ * range (bodies up to 32767).
+ */
+int ak_world_init_arena(ak_world_t *world, ak_fixed_t width,
+                        ak_fixed_t height, ak_vec2_t gravity,
+                        const ak_world_capacity_t *capacity, void *memory,
+                        int32_t size);
+
+// Remove every body and tether and start over, keeping world's storage
+void ak_world_reset(ak_world_t *world, ak_fixed_t width, ak_fixed_t height,
+                    ak_vec2_t gravity);
 ak_body_t *ak_world_add_body(ak_world_t *world, ak_shape_t shape, ak_fixed_t x,
                              ak_fixed_t y, ak_fixed_t mass);
+
+// The tether holds the bodies' handles and goes away with either of them.
 void ak_world_add_tether(ak_world_t *world, ak_body_t *a, ak_body_t *b,
                          ak_fixed_t max_length);
+
+/**
+ * Remove a body in O(1): the last body in world->bodies moves into its
+ * place, so body pointers and ids taken before the call may be stale; keep
+ * handles instead. Returns 0 if handle does not name a body.
+ */
+int ak_world_remove_body(ak_world_t *world, ak_body_handle_t handle);
+
+/**
+ * Add count bodies in one call and write their handles to handles (unless
+ * it is NULL). New dynamic bodies reach the broadphase as one batch at the
+ * start of the next step or query, so a burst of spawns costs about one
+ * broadphase insertion. Returns how many were added; fewer than count only
+ * when the world fills up.
+ */
+int ak_world_add_bodies(ak_world_t *world, const ak_body_def_t *defs,
+                        int count, ak_body_handle_t *handles);
+
+/**
+ * Remove every body named in handles, skipping stale handles (including
+ * repeats). The static set is rebaked once, before the next step, however
+ * many static bodies go. Returns how many were removed.
+ */
+int ak_world_remove_bodies(ak_world_t *world, const ak_body_handle_t *handles,
+                           int count);
+
+// The body a handle names, or NULL (-1) once it has been removed
+ak_body_t *ak_world_get_body(ak_world_t *world, ak_body_handle_t handle);
+int ak_world_body_index(const ak_world_t *world, ak_body_handle_t handle);
+
+// Adds to the force applied on the next step and wakes the body. Writing
+// the force or velocity accessors directly also wakes it on the next step.
+void ak_world_apply_force(ak_world_t *world, ak_body_t *body, ak_vec2_t force);
+void ak_world_wake_body(ak_world_t *world, ak_body_t *body);
+
+/**
+ * Put body in the layers of category and let it collide with those of mask.
+ * Two bodies collide when each one's category shares a bit with the other's
+ * mask; pairs that do not are dropped in the broadphase, before any shape
+ * test. New bodies start with AK_LAYER_DEFAULT and AK_LAYER_ALL. Wakes the
+ * body; a static body's change rebakes the static set before the next step.
+ */
+void ak_world_set_collision_filter(ak_world_t *world, ak_body_t *body,
+                                   uint16_t category, uint16_t mask);
+
 /**
  * Step the physics world by dt.
+ * With AK_SOA and AK_SIMD on an SSE2/AVX2 build, integration runs through a
+ * vector kernel that is bit-identical to the scalar fixed-point path.
  * NOTE: For consistent cross-platform behavior (physics parity), always use a
  * fixed internal timestep (e.g., 1/60s). If a platform runs at a lower frame
  * rate, call this multiple times with the fixed dt.
  */
 void ak_world_step(ak_world_t *world, ak_fixed_t dt);
 
+// Called before each step of ak_world_step_n with the frame that step will
+// produce (world->frame + 1), to apply that frame's inputs.
+typedef void (*ak_input_fn)(ak_world_t *world, int32_t frame, void *user);
+
+/**
+ * Take n steps of dt, calling input (if not NULL) before each one: a
+ * convenience loop over ak_world_step for resimulating after
+ * ak_world_rewind. It costs the same as stepping one frame at a time.
+ */
+void ak_world_step_n(ak_world_t *world, ak_fixed_t dt, int n,
+                     ak_input_fn input, void *user);
+
+#ifdef AK_HASH
+/**
+ * world->hash and world->body_hash are brought up to date by each step for
+ * every body it moved, and by ak_world_restore. They are computed from
+ * field values, never bytes, so builds of any byte order, int width or
+ * struct layout agree as long as the simulation does; compare them between
+ * peers frame by frame, and body by body to find what diverged. After
+ * writing a body's fields between steps, rehash it (or wake it, and the next
+ * step will); ak_world_rehash recomputes everything.
+ */
+void ak_world_rehash_body(ak_world_t *world, ak_body_t *body);
+void ak_world_rehash(ak_world_t *world);
+#endif
+
+#ifdef AK_PROFILE
+/**
+ * Time the phases of every step with clock (e.g. clock_gettime on PC,
+ * getElapsedTime on Playdate or a hardware timer on Jaguar). The counts in
+ * stats are kept with or without a clock. Building without AK_PROFILE
+ * removes the hooks and counters entirely.
+ */
+void ak_world_set_profile_clock(ak_world_t *world, ak_clock_fn clock,
+                                void *user);
+#endif
+
+/**
+ * Rebuild the static-body BVH. Called automatically before the next step or
+ * query after a static body is added; call it yourself at load time to keep
+ * the cost out of gameplay. Static bodies must not be moved after baking.
+ */
+void ak_world_bake_static(ak_world_t *world);
+
+// --- Queries (ak_query.c) ---
+// Static bodies come from the baked BVH; dynamic ones from the broadphase
+// tree (AK_BROADPHASE_TREE) or a linear scan otherwise. The batched forms
+// walk those once per AK_QUERY_PACKET queries instead of once per query.
+
+// Return 0 to stop the query early.
+typedef int (*ak_query_fn)(ak_body_t *body, void *user);
+
+// Same for batches, with the index of the query that found body. Returning 0
+// stops that query only.
+typedef int (*ak_batch_query_fn)(int query, ak_body_t *body, void *user);
+
+/**
+ * Call fn for every body whose bounds overlap box (edges inclusive). Returns
+ * the number of bodies reported.
+ */
+int ak_world_query_aabb(ak_world_t *world, ak_aabb_t box, ak_query_fn fn,
+                        void *user);
+int ak_world_query_aabb_batch(ak_world_t *world, const ak_aabb_t *boxes,
+                              int count, ak_batch_query_fn fn, void *user);
+
+/**
+ * Call fn for every body whose shape contains point (edges inclusive).
+ * Returns the number of bodies reported.
+ */
+int ak_world_query_point(ak_world_t *world, ak_vec2_t point, ak_query_fn fn,
+                         void *user);
+int ak_world_query_point_batch(ak_world_t *world, const ak_vec2_t *points,
+                               int count, ak_batch_query_fn fn, void *user);
+
+typedef struct {
+  ak_body_t *body;     // NULL if the cast hit nothing
+  ak_fixed_t fraction; // Along start -> end, 0 to AK_FIXED_ONE
+  ak_vec2_t point;     // Where the body's surface was hit
+  ak_vec2_t normal;    // Unit surface normal there, facing the cast
+} ak_raycast_hit_t;
+
+typedef struct {
+  ak_vec2_t start, end;
+  ak_fixed_t radius; // 0 for a ray, else the circle swept along it
+} ak_cast_t;
+
+/**
+ * First body the segment start -> end touches. Bodies that already overlap
+ * the start are skipped, so a ray cast from a body's centre sees past it;
+ * equal distances go to the lower body index. Returns 1 and fills hit if
+ * anything was hit, else 0 with hit->body NULL.
+ */
+int ak_world_raycast(ak_world_t *world, ak_vec2_t start, ak_vec2_t end,
+                     ak_raycast_hit_t *hit);
+
+// As ak_world_raycast for a circle of radius swept from start to end
+int ak_world_circle_cast(ak_world_t *world, ak_vec2_t start, ak_vec2_t end,
+                         ak_fixed_t radius, ak_raycast_hit_t *hit);
+
+// hits[i] answers casts[i]. Returns how many casts hit something.
+int ak_world_cast_batch(ak_world_t *world, const ak_cast_t *casts, int count,
+                        ak_raycast_hit_t *hits);
+
 #ifdef __cplusplus
 }
 #endif
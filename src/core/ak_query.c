@@ -0,0 +1,390 @@
+#include "ak_broadphase.h"
+#include <stddef.h>
+
+// Every query runs in packets of up to AK_QUERY_PACKET, bit k of a mask
+// standing for the packet's query k. The broadphase asks a packet which of
+// its queries may have answers inside each node, then offers the bodies of
+// the leaves that some query still wants.
+
+static void Prepare(ak_world_t *world) {
+  if (world->statics.dirty)
+    ak_broadphase_bake_static(world);
+}
+
+static uint32_t PacketMask(int count) {
+  return count >= 32 ? 0xFFFFFFFFUL : ((uint32_t)1 << count) - 1;
+}
+
+// Index of the lowest query left in *live, which it clears
+static int NextQuery(uint32_t *live) {
+  uint32_t bit = *live & ((uint32_t)0 - *live);
+  *live ^= bit;
+  return 31 - AK_FIXED_CLZ32(bit);
+}
+
+static int Overlaps(const ak_aabb_t *a, const ak_aabb_t *b) {
+  return a->min.x <= b->max.x && b->min.x <= a->max.x &&
+         a->min.y <= b->max.y && b->min.y <= a->max.y;
+}
+
+// --- Boxes and Points ---
+
+typedef struct {
+  const ak_aabb_t *boxes;  // This packet's boxes, or NULL for points
+  const ak_vec2_t *points; // This packet's points, or NULL for boxes
+  int first;               // Batch index of the packet's first query
+  int count;
+  ak_batch_query_fn fn;
+  void *user;
+  int found;
+} ak_region_packet_t;
+
+static uint32_t TestBoxes(const ak_aabb_t *box, uint32_t mask, void *ctx) {
+  const ak_region_packet_t *q = (const ak_region_packet_t *)ctx;
+  for (uint32_t live = mask; live;) {
+    int k = NextQuery(&live);
+    if (!Overlaps(box, &q->boxes[k]))
+      mask &= ~((uint32_t)1 << k);
+  }
+  return mask;
+}
+
+static uint32_t TestPoints(const ak_aabb_t *box, uint32_t mask, void *ctx) {
+  const ak_region_packet_t *q = (const ak_region_packet_t *)ctx;
+  for (uint32_t live = mask; live;) {
+    int k = NextQuery(&live);
+    const ak_vec2_t *p = &q->points[k];
+    if (p->x < box->min.x || p->x > box->max.x || p->y < box->min.y ||
+        p->y > box->max.y)
+      mask &= ~((uint32_t)1 << k);
+  }
+  return mask;
+}
+
+static int ContainsPoint(const ak_world_t *world, int body, ak_vec2_t p) {
+  ak_fixed_t dx = AK_FIXED_SUB(p.x, AK_BODY_POS_X(world, body));
+  ak_fixed_t dy = AK_FIXED_SUB(p.y, AK_BODY_POS_Y(world, body));
+  if (AK_BODY_SHAPE_TYPE(world, body) == AK_SHAPE_CIRCLE) {
+    ak_fixed_t r = AK_BODY_RADIUS(world, body);
+    return (int64_t)dx * dx + (int64_t)dy * dy <= (int64_t)r * r;
+  }
+  return AK_FIXED_ABS(dx) <= AK_BODY_HALF_W(world, body) &&
+         AK_FIXED_ABS(dy) <= AK_BODY_HALF_H(world, body);
+}
+
+// Box queries take the bounds test as final; point queries test the shape
+static uint32_t ReportRegion(ak_world_t *world, int body, uint32_t mask,
+                             void *ctx) {
+  ak_region_packet_t *q = (ak_region_packet_t *)ctx;
+  for (uint32_t live = mask; live;) {
+    int k = NextQuery(&live);
+    uint32_t bit = (uint32_t)1 << k;
+    if (q->points && !ContainsPoint(world, body, q->points[k]))
+      continue;
+    q->found++;
+    if (!q->fn(q->first + k, &world->bodies[body], q->user))
+      mask &= ~bit;
+  }
+  return mask;
+}
+
+static int RegionBatch(ak_world_t *world, const ak_aabb_t *boxes,
+                       const ak_vec2_t *points, int count,
+                       ak_batch_query_fn fn, void *user) {
+  ak_region_packet_t q;
+  q.fn = fn;
+  q.user = user;
+  q.found = 0;
+
+  Prepare(world);
+  for (int first = 0; first < count; first += AK_QUERY_PACKET) {
+    q.first = first;
+    q.count = AK_FIXED_MIN(count - first, AK_QUERY_PACKET);
+    q.boxes = boxes ? boxes + first : NULL;
+    q.points = points ? points + first : NULL;
+    ak_broadphase_query_packet(world, PacketMask(q.count),
+                               boxes ? TestBoxes : TestPoints, ReportRegion,
+                               &q);
+  }
+  return q.found;
+}
+
+// The single-query forms are batches of one
+typedef struct {
+  ak_query_fn fn;
+  void *user;
+} ak_single_query_t;
+
+static int ReportSingle(int query, ak_body_t *body, void *user) {
+  ak_single_query_t *s = (ak_single_query_t *)user;
+  (void)query;
+  return s->fn(body, s->user);
+}
+
+int ak_world_query_aabb(ak_world_t *world, ak_aabb_t box, ak_query_fn fn,
+                        void *user) {
+  ak_single_query_t s = {fn, user};
+  return RegionBatch(world, &box, NULL, 1, ReportSingle, &s);
+}
+
+int ak_world_query_aabb_batch(ak_world_t *world, const ak_aabb_t *boxes,
+                              int count, ak_batch_query_fn fn, void *user) {
+  return RegionBatch(world, boxes, NULL, count, fn, user);
+}
+
+int ak_world_query_point(ak_world_t *world, ak_vec2_t point, ak_query_fn fn,
+                         void *user) {
+  ak_single_query_t s = {fn, user};
+  return RegionBatch(world, NULL, &point, 1, ReportSingle, &s);
+}
+
+int ak_world_query_point_batch(ak_world_t *world, const ak_vec2_t *points,
+                               int count, ak_batch_query_fn fn, void *user) {
+  return RegionBatch(world, NULL, points, count, fn, user);
+}
+
+// --- Casts ---
+// Distances are measured along the cast in pixels (16.16), from start. A
+// circle cast is a ray against shapes grown by its radius: circles get
+// radius + r, boxes become rounded boxes.
+
+typedef struct {
+  ak_vec2_t start;
+  ak_vec2_t dir; // Unit direction, 0 for a zero-length cast
+  ak_fixed_t length;
+  ak_fixed_t radius;
+  ak_fixed_t inv_x, inv_y; // 1 / dir, 0 where dir is 0
+  ak_fixed_t best;         // Distance of the closest hit so far
+  int body;                // Its body, -1 if none
+  ak_vec2_t normal;
+  ak_aabb_t bounds; // Of the swept circle from start to best
+} ak_ray_t;
+
+typedef struct {
+  ak_ray_t rays[AK_QUERY_PACKET];
+  int count;
+} ak_cast_packet_t;
+
+static ak_vec2_t PointAt(const ak_ray_t *r, ak_fixed_t t) {
+  return ak_vec2_add(r->start, ak_vec2_mul(r->dir, t));
+}
+
+static ak_fixed_t SignedRecip(ak_fixed_t x) {
+  if (x == 0)
+    return 0;
+  return x < 0 ? -AK_FIXED_RECIP(-x) : AK_FIXED_RECIP(x);
+}
+
+static void Clip(ak_ray_t *r) {
+  ak_vec2_t end = PointAt(r, r->best);
+  r->bounds.min.x = AK_FIXED_MIN(r->start.x, end.x) - r->radius;
+  r->bounds.min.y = AK_FIXED_MIN(r->start.y, end.y) - r->radius;
+  r->bounds.max.x = AK_FIXED_MAX(r->start.x, end.x) + r->radius;
+  r->bounds.max.y = AK_FIXED_MAX(r->start.y, end.y) + r->radius;
+}
+
+static void StartCast(ak_ray_t *r, const ak_cast_t *cast) {
+  r->start = cast->start;
+  r->dir = ak_vec2_normalize(ak_vec2_sub(cast->end, cast->start), &r->length);
+  r->radius = cast->radius;
+  r->inv_x = SignedRecip(r->dir.x);
+  r->inv_y = SignedRecip(r->dir.y);
+  r->best = r->length;
+  r->body = -1;
+  Clip(r);
+}
+
+// Separating axis test of the swept segment (up to best) against box grown
+// by the radius: the bounds cover the box axes, the cross product the
+// segment's normal. No divides, so it is cheap enough for every node.
+static int CastMayHit(const ak_ray_t *r, const ak_aabb_t *box) {
+  if (!Overlaps(&r->bounds, box))
+    return 0;
+  ak_fixed_t hx = ((box->max.x - box->min.x + 1) >> 1) + r->radius;
+  ak_fixed_t hy = ((box->max.y - box->min.y + 1) >> 1) + r->radius;
+  ak_fixed_t cx = box->min.x + ((box->max.x - box->min.x) >> 1) - r->start.x;
+  ak_fixed_t cy = box->min.y + ((box->max.y - box->min.y) >> 1) - r->start.y;
+  ak_fixed_t cross = AK_FIXED_MUL(r->dir.x, cy) - AK_FIXED_MUL(r->dir.y, cx);
+  return AK_FIXED_ABS(cross) <=
+         AK_FIXED_MUL(AK_FIXED_ABS(r->dir.x), hy) +
+             AK_FIXED_MUL(AK_FIXED_ABS(r->dir.y), hx) + 1;
+}
+
+static uint32_t TestCasts(const ak_aabb_t *box, uint32_t mask, void *ctx) {
+  const ak_cast_packet_t *q = (const ak_cast_packet_t *)ctx;
+  for (uint32_t live = mask; live;) {
+    int k = NextQuery(&live);
+    if (!CastMayHit(&q->rays[k], box))
+      mask &= ~((uint32_t)1 << k);
+  }
+  return mask;
+}
+
+// Distance at which the ray meets the circle of radius rad around c, or -1.
+// A circle around the start, or behind it, is missed.
+static ak_fixed_t CastCircle(const ak_ray_t *r, ak_vec2_t c, ak_fixed_t rad) {
+  ak_vec2_t m = ak_vec2_sub(c, r->start);
+  ak_fixed_t perp = AK_FIXED_MUL(r->dir.x, m.y) - AK_FIXED_MUL(r->dir.y, m.x);
+  if (AK_FIXED_ABS(perp) > rad ||
+      (int64_t)m.x * m.x + (int64_t)m.y * m.y < (int64_t)rad * rad)
+    return -1;
+  ak_fixed_t half = (ak_fixed_t)AK_FIXED_ISQRT64(
+      (uint64_t)((int64_t)rad * rad - (int64_t)perp * perp));
+  ak_fixed_t t = ak_vec2_dot(m, r->dir) - half;
+  return t < 0 ? -1 : t;
+}
+
+// Slab test against the box of half extents hx, hy around c. Returns 0 on a
+// miss; otherwise *enter is where the ray enters (negative if the start is
+// inside) and *axis which slab it entered last.
+static int CastBox(const ak_ray_t *r, ak_vec2_t c, ak_fixed_t hx,
+                   ak_fixed_t hy, int64_t *enter, int *axis) {
+  const ak_fixed_t offset[2] = {r->start.x - c.x, r->start.y - c.y};
+  const ak_fixed_t dir[2] = {r->dir.x, r->dir.y};
+  const ak_fixed_t inv[2] = {r->inv_x, r->inv_y};
+  const ak_fixed_t half[2] = {hx, hy};
+  int64_t lo = INT64_MIN, hi = INT64_MAX;
+
+  *axis = 0;
+  for (int a = 0; a < 2; a++) {
+    if (dir[a] == 0) {
+      if (AK_FIXED_ABS(offset[a]) > half[a])
+        return 0;
+      continue;
+    }
+    int64_t t1 = (((int64_t)-half[a] - offset[a]) * inv[a]) >> AK_FIXED_SHIFT;
+    int64_t t2 = (((int64_t)half[a] - offset[a]) * inv[a]) >> AK_FIXED_SHIFT;
+    if (t1 > t2) {
+      int64_t tmp = t1;
+      t1 = t2;
+      t2 = tmp;
+    }
+    if (t1 > lo) {
+      lo = t1;
+      *axis = a;
+    }
+    if (t2 < hi)
+      hi = t2;
+  }
+  *enter = lo;
+  return lo <= hi && hi >= 0;
+}
+
+static ak_fixed_t HitCircle(const ak_ray_t *r, ak_vec2_t c, ak_fixed_t rad,
+                            ak_vec2_t *normal) {
+  ak_fixed_t t = CastCircle(r, c, rad + r->radius);
+  if (t >= 0) {
+    ak_fixed_t len;
+    *normal = ak_vec2_normalize(ak_vec2_sub(PointAt(r, t), c), &len);
+  }
+  return t;
+}
+
+// A circle cast first meets the box grown by its radius. Where that corner
+// is rounded, the rounded part is the circle around the box corner, and the
+// cast can only reach the box through it.
+static ak_fixed_t HitBox(const ak_ray_t *r, ak_vec2_t c, ak_fixed_t hw,
+                         ak_fixed_t hh, ak_vec2_t *normal) {
+  int64_t enter;
+  int axis;
+  if (!CastBox(r, c, hw + r->radius, hh + r->radius, &enter, &axis) ||
+      enter > r->best)
+    return -1;
+
+  if (r->radius > 0) {
+    ak_vec2_t p = PointAt(r, enter > 0 ? (ak_fixed_t)enter : 0);
+    ak_fixed_t dx = p.x - c.x;
+    ak_fixed_t dy = p.y - c.y;
+    if (AK_FIXED_ABS(dx) > hw && AK_FIXED_ABS(dy) > hh) {
+      ak_vec2_t corner = {c.x + (dx > 0 ? hw : -hw),
+                          c.y + (dy > 0 ? hh : -hh)};
+      return HitCircle(r, corner, 0, normal);
+    }
+  }
+  if (enter < 0)
+    return -1; // Started inside
+  if (axis == 0)
+    *normal = (ak_vec2_t){r->dir.x > 0 ? -AK_FIXED_ONE : AK_FIXED_ONE, 0};
+  else
+    *normal = (ak_vec2_t){0, r->dir.y > 0 ? -AK_FIXED_ONE : AK_FIXED_ONE};
+  return (ak_fixed_t)enter;
+}
+
+// Keeps the closest hit of each cast; equal distances go to the lower body
+// index so every broadphase gives the same answer. Casts never stop early.
+static uint32_t ReportCast(ak_world_t *world, int body, uint32_t mask,
+                           void *ctx) {
+  ak_cast_packet_t *q = (ak_cast_packet_t *)ctx;
+  ak_vec2_t c = ak_body_position(world, body);
+  int circle = AK_BODY_SHAPE_TYPE(world, body) == AK_SHAPE_CIRCLE;
+
+  for (uint32_t live = mask; live;) {
+    ak_ray_t *r = &q->rays[NextQuery(&live)];
+    ak_vec2_t normal;
+    ak_fixed_t t;
+    if (circle)
+      t = HitCircle(r, c, AK_BODY_RADIUS(world, body), &normal);
+    else
+      t = HitBox(r, c, AK_BODY_HALF_W(world, body),
+                 AK_BODY_HALF_H(world, body), &normal);
+    if (t < 0 || t > r->best ||
+        (t == r->best && r->body >= 0 && r->body < body))
+      continue;
+    r->best = t;
+    r->body = body;
+    r->normal = normal;
+    Clip(r);
+  }
+  return mask;
+}
+
+static void FinishCast(ak_world_t *world, const ak_ray_t *r,
+                       ak_raycast_hit_t *hit) {
+  if (r->body < 0) {
+    hit->body = NULL;
+    hit->fraction = AK_FIXED_ONE;
+    hit->point = PointAt(r, r->length);
+    hit->normal = (ak_vec2_t){0, 0};
+    return;
+  }
+  hit->body = &world->bodies[r->body];
+  hit->fraction =
+      r->length > 0
+          ? AK_FIXED_MIN(AK_FIXED_DIV(r->best, r->length), AK_FIXED_ONE)
+          : 0;
+  hit->point = ak_vec2_sub(PointAt(r, r->best),
+                           ak_vec2_mul(r->normal, r->radius));
+  hit->normal = r->normal;
+}
+
+int ak_world_cast_batch(ak_world_t *world, const ak_cast_t *casts, int count,
+                        ak_raycast_hit_t *hits) {
+  ak_cast_packet_t q;
+  int hit_count = 0;
+
+  Prepare(world);
+  for (int first = 0; first < count; first += AK_QUERY_PACKET) {
+    q.count = AK_FIXED_MIN(count - first, AK_QUERY_PACKET);
+    for (int k = 0; k < q.count; k++)
+      StartCast(&q.rays[k], &casts[first + k]);
+    ak_broadphase_query_packet(world, PacketMask(q.count), TestCasts,
+                               ReportCast, &q);
+    for (int k = 0; k < q.count; k++) {
+      FinishCast(world, &q.rays[k], &hits[first + k]);
+      hit_count += q.rays[k].body >= 0;
+    }
+  }
+  return hit_count;
+}
+
+int ak_world_raycast(ak_world_t *world, ak_vec2_t start, ak_vec2_t end,
+                     ak_raycast_hit_t *hit) {
+  ak_cast_t cast = {start, end, 0};
+  return ak_world_cast_batch(world, &cast, 1, hit);
+}
+
+int ak_world_circle_cast(ak_world_t *world, ak_vec2_t start, ak_vec2_t end,
+                         ak_fixed_t radius, ak_raycast_hit_t *hit) {
+  ak_cast_t cast = {start, end, radius};
+  return ak_world_cast_batch(world, &cast, 1, hit);
+}
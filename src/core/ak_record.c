@@ -0,0 +1,468 @@
+#include "ak_record.h"
+
+// Layout: magic, version, width, height, gravity, tuning (slop,
+// max_correction, bounce_threshold, solver_iterations, solver_tolerance,
+// sleep_speed, sleep_delay), then records. The starting scene is logged as
+// the body and tether records of frame 0.
+//
+// Record words after the tag:
+//   STEP     dt, then per edit: (fields << 16 | body id) and the new values
+//            of those fields, in AK_LOG_EDIT_* order; a filter is one word,
+//            category << 16 | mask
+//   BODY     shape type | is_static << 8, extents, position, velocity,
+//            force, mass, restitution, sleep_time (tag count = body id)
+//   TETHER   a, b, max_length
+//   GRAVITY  x, y
+//   HASH     frame, ak_log_hash
+//   REMOVE   (tag count = body id); the last body moves into its id
+
+#define AK_LOG_HEADER_WORDS 13
+#define AK_LOG_BODY_WORDS 12
+
+#define AK_LOG_EDIT_POS 1
+#define AK_LOG_EDIT_VEL 2
+#define AK_LOG_EDIT_FORCE 4
+#define AK_LOG_EDIT_SLEEP 8
+#define AK_LOG_EDIT_FILTER 16
+
+#define TAG(type, count) ((uint32_t)(type) << 24 | (uint32_t)(count))
+
+static uint32_t HashWord(uint32_t h, uint32_t v) {
+  h = (h ^ v) * (uint32_t)0x9E3779B1UL;
+  return h ^ (h >> 16);
+}
+
+uint32_t ak_log_hash(const ak_world_t *world) {
+  uint32_t h = (uint32_t)0x811C9DC5UL;
+  for (int i = 0; i < world->body_count; i++) {
+    h = HashWord(h, (uint32_t)AK_BODY_POS_X(world, i));
+    h = HashWord(h, (uint32_t)AK_BODY_POS_Y(world, i));
+    h = HashWord(h, (uint32_t)AK_BODY_VEL_X(world, i));
+    h = HashWord(h, (uint32_t)AK_BODY_VEL_Y(world, i));
+    h = HashWord(h, (uint32_t)AK_BODY_SLEEP_TIME(world, i));
+  }
+  return h;
+}
+
+static void ReadState(const ak_world_t *world, int i, ak_log_body_state_t *s) {
+  s->pos_x = AK_BODY_POS_X(world, i);
+  s->pos_y = AK_BODY_POS_Y(world, i);
+  s->vel_x = AK_BODY_VEL_X(world, i);
+  s->vel_y = AK_BODY_VEL_Y(world, i);
+  s->force_x = AK_BODY_FORCE_X(world, i);
+  s->force_y = AK_BODY_FORCE_Y(world, i);
+  s->sleep_time = AK_BODY_SLEEP_TIME(world, i);
+  s->filter = (uint32_t)world->bodies[i].category << 16 | world->bodies[i].mask;
+}
+
+// --- Recording ---
+
+static void Flush(ak_recorder_t *rec) {
+  if (rec->buffered > 0)
+    rec->write(rec->buffer, rec->buffered, rec->user);
+  rec->buffered = 0;
+}
+
+static void Put(ak_recorder_t *rec, uint32_t v) {
+  uint8_t *p = &rec->buffer[rec->buffered];
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+  rec->buffered += 4;
+  if (rec->buffered == (int)sizeof(rec->buffer))
+    Flush(rec);
+}
+
+static void PutBody(ak_recorder_t *rec, const ak_world_t *world, int i) {
+  const ak_body_t *b = &world->bodies[i];
+  int circle = AK_BODY_SHAPE_TYPE(world, i) == AK_SHAPE_CIRCLE;
+
+  Put(rec, TAG(AK_LOG_BODY, i));
+  Put(rec, (uint32_t)AK_BODY_SHAPE_TYPE(world, i) |
+               (uint32_t)(b->is_static != 0) << 8);
+  Put(rec, (uint32_t)(circle ? AK_BODY_RADIUS(world, i)
+                             : AK_BODY_HALF_W(world, i)));
+  Put(rec, (uint32_t)(circle ? AK_BODY_RADIUS(world, i)
+                             : AK_BODY_HALF_H(world, i)));
+  Put(rec, (uint32_t)AK_BODY_POS_X(world, i));
+  Put(rec, (uint32_t)AK_BODY_POS_Y(world, i));
+  Put(rec, (uint32_t)AK_BODY_VEL_X(world, i));
+  Put(rec, (uint32_t)AK_BODY_VEL_Y(world, i));
+  Put(rec, (uint32_t)AK_BODY_FORCE_X(world, i));
+  Put(rec, (uint32_t)AK_BODY_FORCE_Y(world, i));
+  Put(rec, (uint32_t)AK_BODY_MASS(world, i));
+  Put(rec, (uint32_t)b->restitution);
+  Put(rec, (uint32_t)AK_BODY_SLEEP_TIME(world, i));
+}
+
+// Bodies, tethers and gravity that are new to the log
+static void PutAdded(ak_recorder_t *rec, const ak_world_t *world) {
+  if (world->gravity.x != rec->gravity.x ||
+      world->gravity.y != rec->gravity.y) {
+    Put(rec, TAG(AK_LOG_GRAVITY, 0));
+    Put(rec, (uint32_t)world->gravity.x);
+    Put(rec, (uint32_t)world->gravity.y);
+    rec->gravity = world->gravity;
+  }
+  for (; rec->body_count < world->body_count; rec->body_count++) {
+    PutBody(rec, world, rec->body_count);
+    ak_log_body_state_t *last = &rec->last[rec->body_count];
+    ReadState(world, rec->body_count, last);
+    // Replayed bodies start with the default filter; any other is an edit
+    last->filter = (uint32_t)AK_LAYER_DEFAULT << 16 | AK_LAYER_ALL;
+  }
+  for (; rec->tether_count < world->tether_count; rec->tether_count++) {
+    const ak_tether_t *t = &world->tethers[rec->tether_count];
+    int a = ak_world_body_index(world, t->a);
+    int b = ak_world_body_index(world, t->b);
+    if (a < 0 || b < 0)
+      continue; // Already gone with a removed body
+    Put(rec, TAG(AK_LOG_TETHER, 0));
+    Put(rec, (uint32_t)a);
+    Put(rec, (uint32_t)b);
+    Put(rec, (uint32_t)t->max_length);
+  }
+}
+
+static int EditFields(const ak_log_body_state_t *was,
+                      const ak_log_body_state_t *now) {
+  int fields = 0;
+  if (now->pos_x != was->pos_x || now->pos_y != was->pos_y)
+    fields |= AK_LOG_EDIT_POS;
+  if (now->vel_x != was->vel_x || now->vel_y != was->vel_y)
+    fields |= AK_LOG_EDIT_VEL;
+  if (now->force_x != was->force_x || now->force_y != was->force_y)
+    fields |= AK_LOG_EDIT_FORCE;
+  if (now->sleep_time != was->sleep_time)
+    fields |= AK_LOG_EDIT_SLEEP;
+  if (now->filter != was->filter)
+    fields |= AK_LOG_EDIT_FILTER;
+  return fields;
+}
+
+int ak_record_begin(ak_recorder_t *rec, const ak_world_t *world,
+                    int32_t hash_interval, ak_log_write_fn write, void *user) {
+  if (world->body_capacity > AK_MAX_BODIES)
+    return 0;
+  rec->write = write;
+  rec->user = user;
+  rec->hash_interval = hash_interval;
+  rec->frame = 0;
+  rec->body_count = 0;
+  rec->tether_count = 0;
+  rec->gravity = world->gravity;
+  rec->buffered = 0;
+
+  Put(rec, AK_LOG_MAGIC);
+  Put(rec, AK_LOG_VERSION);
+  Put(rec, (uint32_t)world->width);
+  Put(rec, (uint32_t)world->height);
+  Put(rec, (uint32_t)world->gravity.x);
+  Put(rec, (uint32_t)world->gravity.y);
+  Put(rec, (uint32_t)world->slop);
+  Put(rec, (uint32_t)world->max_correction);
+  Put(rec, (uint32_t)world->bounce_threshold);
+  Put(rec, (uint32_t)world->solver_iterations);
+  Put(rec, (uint32_t)world->solver_tolerance);
+  Put(rec, (uint32_t)world->sleep_speed);
+  Put(rec, (uint32_t)world->sleep_delay);
+  PutAdded(rec, world);
+  Flush(rec);
+  return 1;
+}
+
+void ak_record_step(ak_recorder_t *rec, ak_world_t *world, ak_fixed_t dt) {
+  ak_log_body_state_t now;
+  int edits = 0;
+
+  PutAdded(rec, world);
+  for (int i = 0; i < world->body_count; i++) {
+    ReadState(world, i, &now);
+    edits += EditFields(&rec->last[i], &now) != 0;
+  }
+  Put(rec, TAG(AK_LOG_STEP, edits));
+  Put(rec, (uint32_t)dt);
+  for (int i = 0; edits > 0 && i < world->body_count; i++) {
+    ReadState(world, i, &now);
+    int fields = EditFields(&rec->last[i], &now);
+    if (!fields)
+      continue;
+    Put(rec, (uint32_t)fields << 16 | (uint32_t)i);
+    if (fields & AK_LOG_EDIT_POS) {
+      Put(rec, (uint32_t)now.pos_x);
+      Put(rec, (uint32_t)now.pos_y);
+    }
+    if (fields & AK_LOG_EDIT_VEL) {
+      Put(rec, (uint32_t)now.vel_x);
+      Put(rec, (uint32_t)now.vel_y);
+    }
+    if (fields & AK_LOG_EDIT_FORCE) {
+      Put(rec, (uint32_t)now.force_x);
+      Put(rec, (uint32_t)now.force_y);
+    }
+    if (fields & AK_LOG_EDIT_SLEEP)
+      Put(rec, (uint32_t)now.sleep_time);
+    if (fields & AK_LOG_EDIT_FILTER)
+      Put(rec, now.filter);
+    edits--;
+  }
+
+  ak_world_step(world, dt);
+  rec->frame++;
+  // The step drops tethers left dead by removals
+  rec->tether_count = world->tether_count;
+  for (int i = 0; i < world->body_count; i++)
+    ReadState(world, i, &rec->last[i]);
+
+  if (rec->hash_interval > 0 && rec->frame % rec->hash_interval == 0) {
+    Put(rec, TAG(AK_LOG_HASH, 0));
+    Put(rec, (uint32_t)rec->frame);
+    Put(rec, ak_log_hash(world));
+  }
+  // Each step reaches the log whole, so a session cut short still replays
+  Flush(rec);
+}
+
+int ak_record_remove_body(ak_recorder_t *rec, ak_world_t *world,
+                          ak_body_handle_t handle) {
+  int i = ak_world_body_index(world, handle);
+  if (i < 0)
+    return 0;
+  // Anything added before the removal is logged under the ids it had then
+  PutAdded(rec, world);
+  Put(rec, TAG(AK_LOG_REMOVE, i));
+  ak_world_remove_body(world, handle);
+  rec->body_count--;
+  rec->last[i] = rec->last[rec->body_count];
+  return 1;
+}
+
+void ak_record_end(ak_recorder_t *rec) { Flush(rec); }
+
+// --- Replay ---
+
+static uint32_t Get(ak_replay_t *replay) {
+  const uint8_t *p = &replay->data[replay->pos];
+  replay->pos += 4;
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+static uint32_t Peek(const ak_replay_t *replay, int32_t word) {
+  const uint8_t *p = &replay->data[replay->pos + word * 4];
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+// Words left in the log
+static int32_t Left(const ak_replay_t *replay) {
+  return (replay->size - replay->pos) / 4;
+}
+
+static int GetBody(ak_replay_t *replay, ak_world_t *world, int id) {
+  uint32_t type = Get(replay);
+  ak_fixed_t ex = (ak_fixed_t)Get(replay);
+  ak_fixed_t ey = (ak_fixed_t)Get(replay);
+  ak_fixed_t x = (ak_fixed_t)Get(replay);
+  ak_fixed_t y = (ak_fixed_t)Get(replay);
+  ak_vec2_t vel, force;
+  vel.x = (ak_fixed_t)Get(replay);
+  vel.y = (ak_fixed_t)Get(replay);
+  force.x = (ak_fixed_t)Get(replay);
+  force.y = (ak_fixed_t)Get(replay);
+  ak_fixed_t mass = (ak_fixed_t)Get(replay);
+  ak_fixed_t restitution = (ak_fixed_t)Get(replay);
+  ak_fixed_t sleep_time = (ak_fixed_t)Get(replay);
+
+  ak_shape_t shape;
+  shape.type = (ak_shape_type_t)(type & 0xFF);
+  if (shape.type == AK_SHAPE_CIRCLE) {
+    shape.bounds.circle.radius = ex;
+  } else if (shape.type == AK_SHAPE_AABB) {
+    shape.bounds.aabb.width = ex;
+    shape.bounds.aabb.height = ey;
+  } else {
+    return 0;
+  }
+  if (id != world->body_count || ((type >> 8) != 0) != (mass <= 0))
+    return 0;
+
+  ak_body_t *b = ak_world_add_body(world, shape, x, y, mass);
+  if (!b)
+    return 0;
+  ak_body_set_velocity(world, id, vel);
+  AK_BODY_FORCE_X(world, id) = force.x;
+  AK_BODY_FORCE_Y(world, id) = force.y;
+  AK_BODY_SLEEP_TIME(world, id) = sleep_time;
+  b->restitution = restitution;
+  return 1;
+}
+
+// Words in the STEP record at the read position, or 0 if it runs past the
+// end of the log
+static int32_t StepWords(const ak_replay_t *replay, int edits) {
+  int32_t words = 2;
+  int32_t left = Left(replay);
+  for (int e = 0; e < edits; e++) {
+    if (words >= left)
+      return 0;
+    int fields = (int)(Peek(replay, words) >> 16);
+    words += 1 + ((fields & AK_LOG_EDIT_POS) ? 2 : 0) +
+             ((fields & AK_LOG_EDIT_VEL) ? 2 : 0) +
+             ((fields & AK_LOG_EDIT_FORCE) ? 2 : 0) +
+             ((fields & AK_LOG_EDIT_SLEEP) ? 1 : 0) +
+             ((fields & AK_LOG_EDIT_FILTER) ? 1 : 0);
+  }
+  return words <= left ? words : 0;
+}
+
+static int GetStep(ak_replay_t *replay, ak_world_t *world, int edits,
+                   ak_fixed_t *dt) {
+  *dt = (ak_fixed_t)Get(replay);
+  for (int e = 0; e < edits; e++) {
+    uint32_t w = Get(replay);
+    int fields = (int)(w >> 16);
+    int i = (int)(w & 0xFFFF);
+    if (i >= world->body_count)
+      return -1;
+    if (fields & AK_LOG_EDIT_POS) {
+      AK_BODY_POS_X(world, i) = (ak_fixed_t)Get(replay);
+      AK_BODY_POS_Y(world, i) = (ak_fixed_t)Get(replay);
+    }
+    if (fields & AK_LOG_EDIT_VEL) {
+      AK_BODY_VEL_X(world, i) = (ak_fixed_t)Get(replay);
+      AK_BODY_VEL_Y(world, i) = (ak_fixed_t)Get(replay);
+    }
+    if (fields & AK_LOG_EDIT_FORCE) {
+      AK_BODY_FORCE_X(world, i) = (ak_fixed_t)Get(replay);
+      AK_BODY_FORCE_Y(world, i) = (ak_fixed_t)Get(replay);
+    }
+    ak_fixed_t sleep_time = 0;
+    if (fields & AK_LOG_EDIT_SLEEP)
+      sleep_time = (ak_fixed_t)Get(replay);
+    if (fields & AK_LOG_EDIT_FILTER) {
+      uint32_t filter = Get(replay);
+      ak_world_set_collision_filter(world, &world->bodies[i],
+                                    (uint16_t)(filter >> 16),
+                                    (uint16_t)filter);
+    }
+    // After the filter, which wakes the body
+    if (fields & AK_LOG_EDIT_SLEEP)
+      AK_BODY_SLEEP_TIME(world, i) = sleep_time;
+#ifdef AK_HASH
+    ak_world_rehash_body(world, &world->bodies[i]);
+#endif
+  }
+  replay->frame++;
+  return 1;
+}
+
+int ak_replay_begin(ak_replay_t *replay, ak_world_t *world, const void *log,
+                    int32_t size) {
+  replay->data = (const uint8_t *)log;
+  replay->size = size;
+  replay->pos = 0;
+  replay->frame = 0;
+  replay->hashes = 0;
+  replay->matched = 0;
+  replay->diverged = -1;
+
+  if (Left(replay) < AK_LOG_HEADER_WORDS || Get(replay) != AK_LOG_MAGIC)
+    return 0;
+  // Version 1 logs are version 2 logs without removals, and version 2 logs
+  // are version 3 logs without filter edits
+  uint32_t version = Get(replay);
+  if (version < 1 || version > AK_LOG_VERSION)
+    return 0;
+  ak_fixed_t width = (ak_fixed_t)Get(replay);
+  ak_fixed_t height = (ak_fixed_t)Get(replay);
+  ak_vec2_t gravity;
+  gravity.x = (ak_fixed_t)Get(replay);
+  gravity.y = (ak_fixed_t)Get(replay);
+  ak_world_reset(world, width, height, gravity);
+  world->slop = (ak_fixed_t)Get(replay);
+  world->max_correction = (ak_fixed_t)Get(replay);
+  world->bounce_threshold = (ak_fixed_t)Get(replay);
+  world->solver_iterations = (int)Get(replay);
+  world->solver_tolerance = (ak_fixed_t)Get(replay);
+  world->sleep_speed = (ak_fixed_t)Get(replay);
+  world->sleep_delay = (ak_fixed_t)Get(replay);
+  return 1;
+}
+
+int ak_replay_next(ak_replay_t *replay, ak_world_t *world, ak_fixed_t *dt) {
+  while (Left(replay) > 0) {
+    uint32_t tag = Peek(replay, 0);
+    // 24 bits, wider than int on 16-bit targets: it is checked against the
+    // world before it is used as an int
+    int32_t count = (int32_t)(tag & 0xFFFFFF);
+    int32_t words;
+
+    switch (tag >> 24) {
+    case AK_LOG_STEP:
+      if (count > world->body_count) // At most one edit per body
+        return -1;
+      words = StepWords(replay, (int)count);
+      if (words == 0)
+        return 0;
+      replay->pos += 4;
+      return GetStep(replay, world, (int)count, dt);
+    case AK_LOG_BODY:
+      if (count >= world->body_capacity)
+        return -1;
+      if (Left(replay) < 1 + AK_LOG_BODY_WORDS)
+        return 0;
+      replay->pos += 4;
+      if (!GetBody(replay, world, (int)count))
+        return -1;
+      break;
+    case AK_LOG_TETHER: {
+      if (Left(replay) < 4)
+        return 0;
+      replay->pos += 4;
+      int a = (int)Get(replay);
+      int b = (int)Get(replay);
+      ak_fixed_t length = (ak_fixed_t)Get(replay);
+      if (a < 0 || a >= world->body_count || b < 0 || b >= world->body_count)
+        return -1;
+      ak_world_add_tether(world, &world->bodies[a], &world->bodies[b],
+                          length);
+      break;
+    }
+    case AK_LOG_REMOVE:
+      replay->pos += 4;
+      if (count >= world->body_count ||
+          !ak_world_remove_body(world, world->bodies[count].handle))
+        return -1;
+      break;
+    case AK_LOG_GRAVITY:
+      if (Left(replay) < 3)
+        return 0;
+      replay->pos += 4;
+      world->gravity.x = (ak_fixed_t)Get(replay);
+      world->gravity.y = (ak_fixed_t)Get(replay);
+      break;
+    case AK_LOG_HASH: {
+      if (Left(replay) < 3)
+        return 0;
+      replay->pos += 4;
+      int32_t frame = (int32_t)Get(replay);
+      uint32_t hash = Get(replay);
+      if (frame != replay->frame)
+        return -1;
+      replay->hashes++;
+      if (replay->diverged >= 0)
+        break;
+      if (hash == ak_log_hash(world))
+        replay->matched = frame;
+      else
+        replay->diverged = frame;
+      break;
+    }
+    default:
+      return -1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,119 @@
+#ifndef AK_RECORD_H
+#define AK_RECORD_H
+
+#include "ak_physics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Session logs for regression and performance runs. A recorder writes the
+// starting scene, then one record per step holding every change the game
+// made to the world since the previous step (forces, velocities, moved or
+// woken bodies, collision filters, new and removed bodies, new tethers,
+// gravity), and every
+// hash_interval steps a hash of the state. Replaying the log on any build
+// reproduces the session step by step and reports the first hash that no
+// longer matches.
+//
+// The log is append-only and made of little-endian 32-bit words, so a
+// session recorded on the Jaguar replays on a PC. World tuning fields are
+// logged with the scene and not tracked afterwards.
+
+#define AK_LOG_MAGIC 0x414B4C31u // "AKL1"
+#define AK_LOG_VERSION 3
+
+// Record tags, in the top byte of a record's first word
+#define AK_LOG_STEP 1    // dt, then edits in the low 24 bits' count
+#define AK_LOG_BODY 2    // A body added since the last step
+#define AK_LOG_TETHER 3  // A tether added since the last step
+#define AK_LOG_GRAVITY 4 // New gravity
+#define AK_LOG_HASH 5    // Frame and state hash after that frame's step
+#define AK_LOG_REMOVE 6  // A body removed since the last step
+
+// Receives the log as it grows; the bytes are only valid during the call.
+typedef void (*ak_log_write_fn)(const void *bytes, int32_t size, void *user);
+
+// Body fields the recorder compares between steps
+typedef struct {
+  ak_fixed_t pos_x, pos_y;
+  ak_fixed_t vel_x, vel_y;
+  ak_fixed_t force_x, force_y;
+  ak_fixed_t sleep_time;
+  uint32_t filter; // category << 16 | mask
+} ak_log_body_state_t;
+
+#define AK_LOG_BUFFER_WORDS 64
+
+typedef struct {
+  ak_log_write_fn write;
+  void *user;
+  int32_t hash_interval; // Steps between hash records, 0 for none
+  int32_t frame;         // Steps recorded
+  int body_count;        // Bodies and tethers already in the log
+  int tether_count;
+  ak_vec2_t gravity;
+  ak_log_body_state_t last[AK_MAX_BODIES]; // State after the last step
+  int buffered;
+  uint8_t buffer[AK_LOG_BUFFER_WORDS * 4];
+} ak_recorder_t;
+
+/**
+ * Start a log of world as it is now. Call ak_record_step in place of
+ * ak_world_step from then on, and ak_record_end when done. Returns 0 if
+ * world can hold more than AK_MAX_BODIES bodies, the recorder's size.
+ */
+int ak_record_begin(ak_recorder_t *rec, const ak_world_t *world,
+                    int32_t hash_interval, ak_log_write_fn write, void *user);
+
+// Log the changes made since the last step, then step world by dt.
+void ak_record_step(ak_recorder_t *rec, ak_world_t *world, ak_fixed_t dt);
+
+/**
+ * Remove a body from a world being recorded. Removals must go through here
+ * rather than ak_world_remove_body, so the log follows the bodies that move
+ * into their slots. Returns 0 if handle is stale.
+ */
+int ak_record_remove_body(ak_recorder_t *rec, ak_world_t *world,
+                          ak_body_handle_t handle);
+
+// Write out anything still buffered.
+void ak_record_end(ak_recorder_t *rec);
+
+typedef struct {
+  const uint8_t *data;
+  int32_t size;
+  int32_t pos;
+  int32_t frame;    // Steps replayed
+  int32_t hashes;   // Hash records checked
+  int32_t matched;  // Last hashed frame that matched before any mismatch
+  int32_t diverged; // First hashed frame that did not match, -1 if none
+} ak_replay_t;
+
+/**
+ * Build the log's starting scene into world, which must already be set up
+ * (by ak_world_init or ak_world_init_arena) and is reset here. A scene with
+ * more bodies or tethers than world holds reads as malformed. log must stay
+ * valid, and is only ever read front to back, so a
+ * memory-mapped file streams in as it is replayed. Returns 0 if it is not
+ * a log this build can read.
+ */
+int ak_replay_begin(ak_replay_t *replay, ak_world_t *world, const void *log,
+                    int32_t size);
+
+/**
+ * Check any hashes logged for the last step, then apply the changes logged
+ * before the next one and store its dt. The caller steps the world, so the
+ * step can be timed on its own. Returns 1 when a step is ready, 0 at the
+ * end of the log (a truncated final record counts as the end) and -1 if the
+ * log is malformed.
+ */
+int ak_replay_next(ak_replay_t *replay, ak_world_t *world, ak_fixed_t *dt);
+
+// Hash of every body's position, velocity and rest timer, as logged
+uint32_t ak_log_hash(const ak_world_t *world);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AK_RECORD_H
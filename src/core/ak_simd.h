@@ -0,0 +1,54 @@
+#ifndef AK_SIMD_H
+#define AK_SIMD_H
+
+// Vector kernels (PC only). They walk the contiguous SoA arrays, so they need
+// AK_SOA; AK_SIMD opts in so the default build stays scalar. Every kernel
+// must produce bit-identical results to the scalar fixed-point code.
+#if defined(AK_SIMD) && defined(AK_SOA) && defined(__AVX2__)
+#define AK_SIMD_AVX2
+#define AK_SIMD_LANES 8
+#include <immintrin.h>
+#elif defined(AK_SIMD) && defined(AK_SOA) && defined(__SSE2__)
+#define AK_SIMD_SSE2
+#define AK_SIMD_LANES 4
+#include <emmintrin.h>
+#endif
+
+#include "ak_fixed.h"
+
+#if defined(AK_SIMD_AVX2)
+// AK_FIXED_MUL on 8 lanes. The 64-bit products of the even and odd lanes are
+// shifted right by 16 and their low words interleaved back together; the low
+// 32 bits of the shifted product are exactly what the scalar cast keeps.
+static inline __m256i MulFixed8(__m256i a, __m256i b) {
+  __m256i even = _mm256_mul_epi32(a, b);
+  __m256i odd =
+      _mm256_mul_epi32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+  even = _mm256_srli_epi64(even, AK_FIXED_SHIFT);
+  odd = _mm256_slli_epi64(_mm256_srli_epi64(odd, AK_FIXED_SHIFT), 32);
+  return _mm256_blend_epi32(even, odd, 0xAA);
+}
+#elif defined(AK_SIMD_SSE2)
+// AK_FIXED_MUL on 4 lanes. SSE2 only has an unsigned 32x32->64 multiply, so
+// the signed product is recovered by subtracting (a<0 ? b : 0) + (b<0 ? a : 0)
+// from its high word before shifting right by 16.
+static inline __m128i MulFixed4(__m128i a, __m128i b) {
+  const __m128i lo_mask = _mm_set_epi32(0, -1, 0, -1);
+  __m128i corr = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(a, 31), b),
+                               _mm_and_si128(_mm_srai_epi32(b, 31), a));
+  __m128i even = _mm_mul_epu32(a, b);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  even = _mm_sub_epi64(even, _mm_slli_epi64(corr, 32));
+  odd = _mm_sub_epi64(odd, _mm_andnot_si128(lo_mask, corr));
+  even = _mm_and_si128(_mm_srli_epi64(even, AK_FIXED_SHIFT), lo_mask);
+  odd = _mm_slli_epi64(_mm_srli_epi64(odd, AK_FIXED_SHIFT), 32);
+  return _mm_or_si128(even, odd);
+}
+
+static inline __m128i Select4(__m128i mask, __m128i if_set, __m128i if_clear) {
+  return _mm_or_si128(_mm_and_si128(mask, if_set),
+                      _mm_andnot_si128(mask, if_clear));
+}
+#endif
+
+#endif // AK_SIMD_H
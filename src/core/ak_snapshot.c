@@ -0,0 +1,422 @@
+#include "ak_snapshot.h"
+#include "ak_broadphase.h"
+#include "ak_narrowphase.h"
+
+// Layout: header, bodies[body_count], tethers[tether_count],
+// cached[cached_count]. Every record is a whole number of 32-bit words.
+
+static int32_t SnapshotSize(int32_t bodies, int32_t tethers, int32_t cached) {
+  return (int32_t)sizeof(ak_snapshot_header_t) +
+         bodies * (int32_t)sizeof(ak_snapshot_body_t) +
+         tethers * (int32_t)sizeof(ak_snapshot_tether_t) +
+         cached * (int32_t)sizeof(ak_cached_contact_t);
+}
+
+// Tethers and cache entries of bodies removed since the last step linger
+// until the next one; snapshots leave them out.
+static int LiveSlot(const ak_world_t *world, int slot) {
+  if (slot >= world->handle_count)
+    return 0;
+  int i = world->handle_body[slot];
+  return i >= 0 && i < world->body_count &&
+         AK_HANDLE_SLOT(world->bodies[i].handle) == slot;
+}
+
+static int LiveTether(const ak_world_t *world, const ak_tether_t *t) {
+  return ak_world_body_index(world, t->a) >= 0 &&
+         ak_world_body_index(world, t->b) >= 0;
+}
+
+static int LiveEntry(const ak_world_t *world, const ak_cached_contact_t *e) {
+  return LiveSlot(world, AK_PAIR_KEY_A(e->key)) &&
+         LiveSlot(world, AK_PAIR_KEY_B(e->key));
+}
+
+static int LiveTethers(const ak_world_t *world) {
+  int count = 0;
+  for (int t = 0; t < world->tether_count; t++)
+    count += LiveTether(world, &world->tethers[t]);
+  return count;
+}
+
+static int LiveEntries(const ak_world_t *world) {
+  const ak_contact_cache_t *cache = &world->contact_cache;
+  const ak_cached_contact_t *front = cache->entries[cache->front];
+  int count = 0;
+  for (int c = 0; c < cache->count[cache->front]; c++)
+    count += LiveEntry(world, &front[c]);
+  return count;
+}
+
+int32_t ak_snapshot_size(const ak_world_t *world) {
+  return SnapshotSize(world->body_count, LiveTethers(world),
+                      LiveEntries(world));
+}
+
+// --- Save ---
+
+static void SaveBody(const ak_world_t *world, int i, ak_snapshot_body_t *s) {
+  s->pos_x = AK_BODY_POS_X(world, i);
+  s->pos_y = AK_BODY_POS_Y(world, i);
+  s->vel_x = AK_BODY_VEL_X(world, i);
+  s->vel_y = AK_BODY_VEL_Y(world, i);
+  s->force_x = AK_BODY_FORCE_X(world, i);
+  s->force_y = AK_BODY_FORCE_Y(world, i);
+  s->sleep_time = AK_BODY_SLEEP_TIME(world, i);
+  s->mass = AK_BODY_MASS(world, i);
+  s->inv_mass = AK_BODY_INV_MASS(world, i);
+  s->restitution = world->bodies[i].restitution;
+  s->shape_type = (uint8_t)AK_BODY_SHAPE_TYPE(world, i);
+  s->is_static = (uint8_t)world->bodies[i].is_static;
+  s->list_index = (int16_t)world->bodies[i].list_index;
+  s->handle = world->bodies[i].handle;
+  s->category = world->bodies[i].category;
+  s->mask = world->bodies[i].mask;
+  if (s->shape_type == AK_SHAPE_CIRCLE) {
+    s->extent_x = AK_BODY_RADIUS(world, i);
+    s->extent_y = s->extent_x;
+  } else {
+    s->extent_x = AK_BODY_HALF_W(world, i);
+    s->extent_y = AK_BODY_HALF_H(world, i);
+  }
+}
+
+int32_t ak_world_save(const ak_world_t *world, void *buf, int32_t capacity) {
+  const ak_contact_cache_t *cache = &world->contact_cache;
+  int tether_count = LiveTethers(world);
+  int cached = LiveEntries(world);
+  int32_t size = SnapshotSize(world->body_count, tether_count, cached);
+
+  if (size > capacity)
+    return 0;
+
+  ak_snapshot_header_t *h = (ak_snapshot_header_t *)buf;
+  h->magic = AK_SNAPSHOT_MAGIC;
+  h->size = size;
+  h->body_count = (int16_t)world->body_count;
+  h->tether_count = (int16_t)tether_count;
+  h->cached_count = (int16_t)cached;
+  h->reserved = 0;
+  h->gravity = world->gravity;
+
+  ak_snapshot_body_t *bodies = (ak_snapshot_body_t *)(h + 1);
+  for (int i = 0; i < world->body_count; i++)
+    SaveBody(world, i, &bodies[i]);
+
+  ak_snapshot_tether_t *tethers =
+      (ak_snapshot_tether_t *)(bodies + world->body_count);
+  int n = 0;
+  for (int t = 0; t < world->tether_count; t++) {
+    const ak_tether_t *tether = &world->tethers[t];
+    if (!LiveTether(world, tether))
+      continue;
+    tethers[n].a = (int16_t)ak_world_body_index(world, tether->a);
+    tethers[n].b = (int16_t)ak_world_body_index(world, tether->b);
+    tethers[n].max_length = tether->max_length;
+    n++;
+  }
+
+  ak_cached_contact_t *entries = (ak_cached_contact_t *)(tethers + n);
+  const ak_cached_contact_t *front = cache->entries[cache->front];
+  n = 0;
+  for (int c = 0; c < cache->count[cache->front]; c++) {
+    if (LiveEntry(world, &front[c]))
+      entries[n++] = front[c];
+  }
+  return size;
+}
+
+// --- Restore ---
+
+static void LoadBody(ak_world_t *world, int i, const ak_snapshot_body_t *s) {
+  ak_body_t *b = &world->bodies[i];
+  b->id = i;
+  AK_BODY_POS_X(world, i) = s->pos_x;
+  AK_BODY_POS_Y(world, i) = s->pos_y;
+  AK_BODY_VEL_X(world, i) = s->vel_x;
+  AK_BODY_VEL_Y(world, i) = s->vel_y;
+  AK_BODY_FORCE_X(world, i) = s->force_x;
+  AK_BODY_FORCE_Y(world, i) = s->force_y;
+  AK_BODY_SLEEP_TIME(world, i) = s->sleep_time;
+  AK_BODY_MASS(world, i) = s->mass;
+  AK_BODY_INV_MASS(world, i) = s->inv_mass;
+  b->restitution = s->restitution;
+  b->is_static = s->is_static;
+  b->list_index = s->list_index;
+  b->handle = s->handle;
+  b->category = s->category;
+  b->mask = s->mask;
+#ifdef AK_SOA
+  world->soa.shape_type[i] = (uint8_t)s->shape_type;
+  world->soa.extent_x[i] = s->extent_x;
+  world->soa.extent_y[i] = s->extent_y;
+#else
+  b->shape.type = (ak_shape_type_t)s->shape_type;
+  if (s->shape_type == AK_SHAPE_CIRCLE) {
+    b->shape.bounds.circle.radius = s->extent_x;
+  } else {
+    b->shape.bounds.aabb.width = s->extent_x;
+    b->shape.bounds.aabb.height = s->extent_y;
+  }
+#endif
+}
+
+// The broadphase and static BVH only depend on which bodies exist, their
+// collision filters and where the static ones are, so a rollback within one
+// level can keep them.
+static int SameBodies(const ak_world_t *world, const ak_snapshot_body_t *s,
+                      int count) {
+  if (count != world->body_count)
+    return 0;
+  for (int i = 0; i < count; i++) {
+    if (s[i].is_static != world->bodies[i].is_static ||
+        s[i].list_index != world->bodies[i].list_index ||
+        s[i].handle != world->bodies[i].handle ||
+        s[i].category != world->bodies[i].category ||
+        s[i].mask != world->bodies[i].mask)
+      return 0;
+    if (!s[i].is_static)
+      continue;
+    if (s[i].pos_x != AK_BODY_POS_X(world, i) ||
+        s[i].pos_y != AK_BODY_POS_Y(world, i) ||
+        s[i].shape_type != (uint8_t)AK_BODY_SHAPE_TYPE(world, i))
+      return 0;
+    ak_fixed_t ex = AK_BODY_SHAPE_TYPE(world, i) == AK_SHAPE_CIRCLE
+                        ? AK_BODY_RADIUS(world, i)
+                        : AK_BODY_HALF_W(world, i);
+    ak_fixed_t ey = AK_BODY_SHAPE_TYPE(world, i) == AK_SHAPE_CIRCLE
+                        ? AK_BODY_RADIUS(world, i)
+                        : AK_BODY_HALF_H(world, i);
+    if (s[i].extent_x != ex || s[i].extent_y != ey)
+      return 0;
+  }
+  return 1;
+}
+
+// Puts every body back at its saved list position. Removals leave the lists
+// out of index order, and the order they are walked in shows in the results.
+static int PlaceInLists(ak_world_t *world) {
+  int ok = 1;
+  world->dynamic_count = 0;
+  world->statics.count = 0;
+  for (int i = 0; i < world->body_count; i++) {
+    if (world->bodies[i].is_static)
+      world->statics.order[world->statics.count++] = -1;
+    else
+      world->dynamic_bodies[world->dynamic_count++] = -1;
+  }
+  for (int i = 0; i < world->body_count; i++) {
+    ak_body_t *b = &world->bodies[i];
+    int16_t *list = b->is_static ? world->statics.order : world->dynamic_bodies;
+    int count = b->is_static ? world->statics.count : world->dynamic_count;
+    if (b->list_index < 0 || b->list_index >= count ||
+        list[b->list_index] >= 0)
+      ok = 0;
+    else
+      list[b->list_index] = (int16_t)i;
+  }
+  return ok;
+}
+
+// Re-registers every body, as adding them one by one would have
+static void RebuildBodyLists(ak_world_t *world) {
+  if (!PlaceInLists(world)) {
+    // Positions clash: fall back to index order
+    world->dynamic_count = 0;
+    world->statics.count = 0;
+    for (int i = 0; i < world->body_count; i++) {
+      ak_body_t *b = &world->bodies[i];
+      if (b->is_static) {
+        b->list_index = world->statics.count;
+        world->statics.order[world->statics.count++] = (int16_t)i;
+      } else {
+        b->list_index = world->dynamic_count;
+        world->dynamic_bodies[world->dynamic_count++] = (int16_t)i;
+      }
+    }
+  }
+  world->statics.node_count = 0;
+  ak_broadphase_init(world);
+  for (int d = 0; d < world->dynamic_count; d++)
+    ak_broadphase_add(world, world->dynamic_bodies[d]);
+  world->statics.dirty = world->statics.count > 0;
+}
+
+// Points each saved handle at its body again. The other slots become free,
+// lowest first; generations only grow, so handles from before the restore
+// never come back to life as a different body.
+static void RebuildHandles(ak_world_t *world) {
+  int count = world->handle_count;
+  for (int i = 0; i < world->body_count; i++) {
+    int slot = AK_HANDLE_SLOT(world->bodies[i].handle);
+    if (slot >= count)
+      count = slot + 1;
+  }
+  for (int slot = 0; slot < count; slot++)
+    world->handle_body[slot] = -1;
+  for (int i = 0; i < world->body_count; i++) {
+    ak_body_handle_t handle = world->bodies[i].handle;
+    int slot = AK_HANDLE_SLOT(handle);
+    uint16_t generation = (uint16_t)(handle >> 16);
+    world->handle_body[slot] = (int16_t)i;
+    if (world->handle_generation[slot] < generation)
+      world->handle_generation[slot] = generation;
+  }
+  world->handle_count = count;
+  world->handle_free = -1;
+  world->handle_limbo = -1;
+  for (int slot = count - 1; slot >= 0; slot--) {
+    if (world->handle_body[slot] < 0) {
+      world->handle_body[slot] = (int16_t)world->handle_free;
+      world->handle_free = slot;
+    }
+  }
+}
+
+int ak_world_restore(ak_world_t *world, const void *buf, int32_t size) {
+  const ak_snapshot_header_t *h = (const ak_snapshot_header_t *)buf;
+
+  if (size < (int32_t)sizeof(*h) || h->magic != AK_SNAPSHOT_MAGIC ||
+      h->size != size)
+    return 0;
+  if (h->body_count < 0 || h->body_count > world->body_capacity ||
+      h->tether_count < 0 || h->tether_count > world->tether_capacity ||
+      h->cached_count < 0 || h->cached_count > world->contact_cache.capacity)
+    return 0;
+  if (size != SnapshotSize(h->body_count, h->tether_count, h->cached_count))
+    return 0;
+
+  const ak_snapshot_body_t *bodies = (const ak_snapshot_body_t *)(h + 1);
+  const ak_snapshot_tether_t *tethers =
+      (const ak_snapshot_tether_t *)(bodies + h->body_count);
+  const ak_cached_contact_t *cached =
+      (const ak_cached_contact_t *)(tethers + h->tether_count);
+  for (int i = 0; i < h->body_count; i++) {
+    if (AK_HANDLE_SLOT(bodies[i].handle) >= world->body_capacity ||
+        (bodies[i].handle >> 16) == 0)
+      return 0;
+  }
+  for (int t = 0; t < h->tether_count; t++) {
+    if (tethers[t].a < 0 || tethers[t].a >= h->body_count ||
+        tethers[t].b < 0 || tethers[t].b >= h->body_count)
+      return 0;
+  }
+
+  int same = SameBodies(world, bodies, h->body_count);
+  world->body_count = h->body_count;
+  for (int i = 0; i < h->body_count; i++)
+    LoadBody(world, i, &bodies[i]);
+  if (!same) {
+    RebuildBodyLists(world);
+    RebuildHandles(world);
+  }
+
+  world->tether_count = h->tether_count;
+  world->tethers_stale = 0;
+  for (int t = 0; t < h->tether_count; t++) {
+    world->tethers[t].a = world->bodies[tethers[t].a].handle;
+    world->tethers[t].b = world->bodies[tethers[t].b].handle;
+    world->tethers[t].max_length = tethers[t].max_length;
+  }
+
+  ak_contact_cache_t *cache = &world->contact_cache;
+  for (int c = 0; c < h->cached_count; c++)
+    cache->entries[cache->front][c] = cached[c];
+  cache->count[cache->front] = h->cached_count;
+  cache->count[cache->front ^ 1] = 0;
+  cache->sorted = 1;
+
+  world->gravity = h->gravity;
+  world->pair_count = 0;
+#ifdef AK_HASH
+  ak_world_rehash(world);
+#endif
+  return 1;
+}
+
+// --- Deltas ---
+// After a two-word header (magic, size of the snapshot it rebuilds), a delta
+// is a list of runs over the snapshot's 32-bit words: one word packing
+// (words to keep from base << 16 | words that follow), then those words.
+// Words past the end of the last run are kept from base.
+
+#define DELTA_MAX_RUN 0xFFFF
+
+int32_t ak_snapshot_delta(const void *base, int32_t base_size,
+                          const void *snap, int32_t size, void *out,
+                          int32_t capacity) {
+  const uint32_t *from = (const uint32_t *)base;
+  const uint32_t *to = (const uint32_t *)snap;
+  uint32_t *w = (uint32_t *)out;
+  int32_t base_words = base_size / 4;
+  int32_t words = size / 4;
+  int32_t room = capacity / 4;
+  int32_t n = 2;
+
+  if (room < 2)
+    return 0;
+  w[0] = AK_DELTA_MAGIC;
+  w[1] = (uint32_t)size;
+
+  int32_t i = 0;
+  while (i < words) {
+    // Unchanged words, up to the next difference
+    int32_t keep = 0;
+    while (i < words && i < base_words && to[i] == from[i] &&
+           keep < DELTA_MAX_RUN) {
+      i++;
+      keep++;
+    }
+    if (i == words)
+      break; // The tail matches base
+
+    int32_t copy = 0;
+    while (i + copy < words && copy < DELTA_MAX_RUN &&
+           (i + copy >= base_words || to[i + copy] != from[i + copy]))
+      copy++;
+    if (n + 1 + copy > room)
+      return 0;
+    w[n++] = (uint32_t)keep << 16 | (uint32_t)copy;
+    for (int32_t k = 0; k < copy; k++)
+      w[n++] = to[i + k];
+    i += copy;
+  }
+  return n * 4;
+}
+
+int32_t ak_snapshot_apply_delta(const void *base, int32_t base_size,
+                                const void *delta, int32_t delta_size,
+                                void *out, int32_t capacity) {
+  const uint32_t *from = (const uint32_t *)base;
+  const uint32_t *d = (const uint32_t *)delta;
+  uint32_t *to = (uint32_t *)out;
+  int32_t base_words = base_size / 4;
+  int32_t delta_words = delta_size / 4;
+
+  if (delta_words < 2 || d[0] != AK_DELTA_MAGIC)
+    return 0;
+  int32_t size = (int32_t)d[1];
+  int32_t words = size / 4;
+  if (size < 0 || size > capacity)
+    return 0;
+
+  int32_t i = 0;
+  int32_t n = 2;
+  while (n < delta_words) {
+    int32_t keep = (int32_t)(d[n] >> 16);
+    int32_t copy = (int32_t)(d[n] & DELTA_MAX_RUN);
+    n++;
+    if (i + keep > base_words || i + keep + copy > words ||
+        n + copy > delta_words)
+      return 0;
+    for (int32_t k = 0; k < keep; k++, i++)
+      to[i] = from[i];
+    for (int32_t k = 0; k < copy; k++)
+      to[i++] = d[n++];
+  }
+  if (i < words && words > base_words)
+    return 0;
+  for (; i < words; i++)
+    to[i] = from[i];
+  return size;
+}
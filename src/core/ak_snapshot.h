@@ -0,0 +1,100 @@
+#ifndef AK_SNAPSHOT_H
+#define AK_SNAPSHOT_H
+
+#include "ak_physics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// World snapshots for rollback. A snapshot holds the live bodies with their
+// handles and body list positions, the tethers as body indices and the
+// warm-start cache, so it restores into any world at any address and a
+// restored world steps bit-identically to the one saved.
+// Tuning fields (slop, solver_iterations, sleep_delay, ...) and the profile
+// clock are not saved; they stay as the receiving world has them.
+//
+// Snapshots are arrays of native-endian 32-bit words: buffers must be 4-byte
+// aligned and are only portable between builds of the same byte order.
+
+#define AK_SNAPSHOT_MAGIC 0x414B5333u // "AKS3"
+#define AK_DELTA_MAGIC 0x414B4431u    // "AKD1"
+
+typedef struct {
+  uint32_t magic;
+  int32_t size; // Bytes, this header included
+  int16_t body_count;
+  int16_t tether_count;
+  int16_t cached_count; // Warm-start cache entries
+  int16_t reserved;
+  ak_vec2_t gravity;
+} ak_snapshot_header_t;
+
+typedef struct {
+  ak_fixed_t pos_x, pos_y;
+  ak_fixed_t vel_x, vel_y;
+  ak_fixed_t force_x, force_y;
+  ak_fixed_t sleep_time;
+  ak_fixed_t mass, inv_mass;
+  ak_fixed_t restitution;
+  ak_fixed_t extent_x, extent_y; // Radius twice, or half-width/half-height
+  uint8_t shape_type;
+  uint8_t is_static;
+  int16_t list_index; // In the static or dynamic body list
+  ak_body_handle_t handle;
+  uint16_t category, mask; // Collision filter
+} ak_snapshot_body_t;
+
+typedef struct {
+  int16_t a, b; // Body indices
+  ak_fixed_t max_length;
+} ak_snapshot_tether_t;
+
+// Largest snapshot this build can produce
+#define AK_SNAPSHOT_MAX_BYTES                                                  \
+  (sizeof(ak_snapshot_header_t) +                                              \
+   AK_MAX_BODIES * sizeof(ak_snapshot_body_t) +                                \
+   AK_MAX_TETHERS * sizeof(ak_snapshot_tether_t) +                             \
+   AK_MAX_CACHED_CONTACTS * sizeof(ak_cached_contact_t))
+
+// Bytes ak_world_save needs for the world as it is now
+int32_t ak_snapshot_size(const ak_world_t *world);
+
+/**
+ * Write a snapshot of world into buf. Returns the bytes written, or 0 if
+ * capacity is too small.
+ */
+int32_t ak_world_save(const ak_world_t *world, void *buf, int32_t capacity);
+
+/**
+ * Replace world's bodies, tethers and warm-start cache with a snapshot. When
+ * the snapshot has the same bodies as the world (same count, handles and
+ * list positions, same static bodies in the same places), the broadphase
+ * and static BVH are kept; otherwise they are rebuilt, and handles of
+ * bodies the snapshot does not hold stop working. Returns 0, leaving world
+ * untouched, if the snapshot is malformed or too big for world's
+ * capacities.
+ */
+int ak_world_restore(ak_world_t *world, const void *buf, int32_t size);
+
+/**
+ * Encode snap as the words that differ from base, usually a snapshot of an
+ * earlier frame. Bodies at rest cost nothing. Returns the bytes written, or
+ * 0 if capacity is too small.
+ */
+int32_t ak_snapshot_delta(const void *base, int32_t base_size,
+                          const void *snap, int32_t size, void *out,
+                          int32_t capacity);
+
+/**
+ * Rebuild the snapshot a delta was made from, given the same base. Returns
+ * its size in bytes, or 0 if the delta is malformed or capacity too small.
+ */
+int32_t ak_snapshot_apply_delta(const void *base, int32_t base_size,
+                                const void *delta, int32_t delta_size,
+                                void *out, int32_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AK_SNAPSHOT_H
@@ -0,0 +1,105 @@
+#include "ak_threads.h"
+
+#ifdef AK_THREADS
+#include <pthread.h>
+#include <stdint.h>
+
+// One pool shared by all worlds. Workers sleep on `wake` until the
+// generation changes, then claim job indices from a shared counter until the
+// range is exhausted; the stepping thread claims jobs alongside them.
+static struct {
+  pthread_t threads[AK_MAX_THREADS];
+  int count; // Worker threads running
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  unsigned generation;
+  int busy; // Workers still on the current generation
+  int quit;
+  ak_job_fn fn;
+  ak_world_t *world;
+  int job_count;
+  int next_job;
+} pool = {.lock = PTHREAD_MUTEX_INITIALIZER,
+          .wake = PTHREAD_COND_INITIALIZER,
+          .done = PTHREAD_COND_INITIALIZER};
+
+static void RunJobs(void) {
+  for (;;) {
+    int i = __atomic_fetch_add(&pool.next_job, 1, __ATOMIC_RELAXED);
+    if (i >= pool.job_count)
+      return;
+    pool.fn(pool.world, i);
+  }
+}
+
+// arg carries the generation current when the worker was created, so a job
+// posted before the thread first takes the lock is not mistaken for old.
+static void *Worker(void *arg) {
+  unsigned seen = (unsigned)(uintptr_t)arg;
+  pthread_mutex_lock(&pool.lock);
+  for (;;) {
+    while (pool.generation == seen && !pool.quit)
+      pthread_cond_wait(&pool.wake, &pool.lock);
+    if (pool.quit)
+      break;
+    seen = pool.generation;
+    pthread_mutex_unlock(&pool.lock);
+
+    RunJobs();
+
+    pthread_mutex_lock(&pool.lock);
+    if (--pool.busy == 0)
+      pthread_cond_signal(&pool.done);
+  }
+  pthread_mutex_unlock(&pool.lock);
+  return NULL;
+}
+
+int ak_threads_run(ak_world_t *world, ak_job_fn fn, int count) {
+  if (pool.count == 0 || count < 2)
+    return 0;
+
+  pthread_mutex_lock(&pool.lock);
+  pool.fn = fn;
+  pool.world = world;
+  pool.job_count = count;
+  pool.next_job = 0;
+  pool.busy = pool.count;
+  pool.generation++;
+  pthread_cond_broadcast(&pool.wake);
+  pthread_mutex_unlock(&pool.lock);
+
+  RunJobs();
+
+  pthread_mutex_lock(&pool.lock);
+  while (pool.busy > 0)
+    pthread_cond_wait(&pool.done, &pool.lock);
+  pthread_mutex_unlock(&pool.lock);
+  return 1;
+}
+
+int ak_set_thread_count(int count) {
+  if (pool.count > 0) {
+    pthread_mutex_lock(&pool.lock);
+    pool.quit = 1;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+    for (int i = 0; i < pool.count; i++)
+      pthread_join(pool.threads[i], NULL);
+    pool.count = 0;
+    pool.quit = 0;
+  }
+
+  int workers = count - 1;
+  if (workers > AK_MAX_THREADS)
+    workers = AK_MAX_THREADS;
+  void *generation = (void *)(uintptr_t)pool.generation;
+  while (pool.count < workers &&
+         pthread_create(&pool.threads[pool.count], NULL, Worker,
+                        generation) == 0)
+    pool.count++;
+  return pool.count + 1;
+}
+
+#endif // AK_THREADS
@@ -0,0 +1,38 @@
+#ifndef AK_THREADS_H
+#define AK_THREADS_H
+
+#include "ak_physics.h"
+
+#ifdef AK_THREADS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Upper bound on worker threads (the stepping thread is not counted).
+#ifndef AK_MAX_THREADS
+#define AK_MAX_THREADS 63
+#endif
+
+// Batches with fewer contacts are solved on the stepping thread; waking the
+// pool costs more than it saves.
+#ifndef AK_THREADS_MIN_CONTACTS
+#define AK_THREADS_MIN_CONTACTS 256
+#endif
+
+typedef void (*ak_job_fn)(ak_world_t *world, int index);
+
+/**
+ * Run fn(world, i) for every i in [0, count) on the worker pool and the
+ * calling thread, returning once all have finished. Jobs must not touch
+ * each other's state. Returns 0, without running anything, when no pool is
+ * active.
+ */
+int ak_threads_run(ak_world_t *world, ak_job_fn fn, int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AK_THREADS
+#endif // AK_THREADS_H
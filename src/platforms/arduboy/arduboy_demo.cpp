@@ -1,13 +1,20 @@
 /*
  * Alpha Kinetics - Arduboy FX Demo
- * Note: AK_MAX_BODIES must be reduced (e.g., 16) in the build flags
- * to fit in the 2.5KB RAM of the ATmega32u4.
+ * Note: the world's capacities must be reduced in the build flags (see
+ * ARDUBOY_FLAGS in the Makefile) to fit in the 2.5KB RAM of the ATmega32u4.
  */
 
 #include "ak_demo_setup.h"
 #include "ak_physics.h"
 #include <Arduboy2.h>
 
+// The frame buffer and the world share the ATmega32u4's RAM with the stack
+#define ARDUBOY_RAM_BYTES 2560
+#define ARDUBOY_STACK_BYTES 224
+static_assert(sizeof(ak_world_t) + WIDTH * HEIGHT / 8 + ARDUBOY_STACK_BYTES <=
+                  ARDUBOY_RAM_BYTES,
+              "ak_world_t does not fit: lower the capacities in ARDUBOY_FLAGS");
+
 Arduboy2 arduboy;
 ak_world_t world;
 
@@ -40,16 +47,15 @@ void loop() {
   arduboy.clear();
 
   for (int i = 0; i < world.body_count; i++) {
-    ak_body_t *b = &world.bodies[i];
-    int x = AK_FIXED_TO_INT(b->position.x);
-    int y = AK_FIXED_TO_INT(b->position.y);
+    int x = AK_FIXED_TO_INT(AK_BODY_POS_X(&world, i));
+    int y = AK_FIXED_TO_INT(AK_BODY_POS_Y(&world, i));
 
-    if (b->shape.type == AK_SHAPE_CIRCLE) {
-      int r = AK_FIXED_TO_INT(b->shape.bounds.circle.radius);
+    if (AK_BODY_SHAPE_TYPE(&world, i) == AK_SHAPE_CIRCLE) {
+      int r = AK_FIXED_TO_INT(AK_BODY_RADIUS(&world, i));
       arduboy.drawCircle(x, y, r, WHITE);
-    } else if (b->shape.type == AK_SHAPE_AABB) {
-      int w = AK_FIXED_TO_INT(b->shape.bounds.aabb.width);
-      int h = AK_FIXED_TO_INT(b->shape.bounds.aabb.height);
+    } else if (AK_BODY_SHAPE_TYPE(&world, i) == AK_SHAPE_AABB) {
+      int w = AK_FIXED_TO_INT(AK_BODY_HALF_W(&world, i));
+      int h = AK_FIXED_TO_INT(AK_BODY_HALF_H(&world, i));
       arduboy.drawRect(x - w, y - h, w * 2, h * 2, WHITE);
     }
   }
@@ -57,10 +63,14 @@ void loop() {
   // Draw Tethers
   for (int i = 0; i < world.tether_count; i++) {
     ak_tether_t *t = &world.tethers[i];
-    arduboy.drawLine(AK_FIXED_TO_INT(t->a->position.x),
-                     AK_FIXED_TO_INT(t->a->position.y),
-                     AK_FIXED_TO_INT(t->b->position.x),
-                     AK_FIXED_TO_INT(t->b->position.y), WHITE);
+    int a = ak_world_body_index(&world, t->a);
+    int b = ak_world_body_index(&world, t->b);
+    if (a < 0 || b < 0)
+      continue;
+    arduboy.drawLine(AK_FIXED_TO_INT(AK_BODY_POS_X(&world, a)),
+                     AK_FIXED_TO_INT(AK_BODY_POS_Y(&world, a)),
+                     AK_FIXED_TO_INT(AK_BODY_POS_X(&world, b)),
+                     AK_FIXED_TO_INT(AK_BODY_POS_Y(&world, b)), WHITE);
   }
 
   arduboy.display();
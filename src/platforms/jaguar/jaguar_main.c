@@ -41,16 +41,16 @@ void RenderWorld(ak_world_t *world) {
 
   for (int i = 0; i < world->body_count; i++) {
     ak_body_t *b = &world->bodies[i];
-    int x = AK_FIXED_TO_INT(b->position.x);
-    int y = AK_FIXED_TO_INT(b->position.y);
+    int x = AK_FIXED_TO_INT(AK_BODY_POS_X(world, i));
+    int y = AK_FIXED_TO_INT(AK_BODY_POS_Y(world, i));
 
-    if (b->shape.type == AK_SHAPE_CIRCLE) {
-      int r = AK_FIXED_TO_INT(b->shape.bounds.circle.radius);
+    if (AK_BODY_SHAPE_TYPE(world, i) == AK_SHAPE_CIRCLE) {
+      int r = AK_FIXED_TO_INT(AK_BODY_RADIUS(world, i));
       demo_bitmap_draw_circle(&main_screen, x, y, r,
                               b->is_static ? COL_BLUE : COL_RED);
-    } else if (b->shape.type == AK_SHAPE_AABB) {
-      int w = AK_FIXED_TO_INT(b->shape.bounds.aabb.width);
-      int h = AK_FIXED_TO_INT(b->shape.bounds.aabb.height);
+    } else if (AK_BODY_SHAPE_TYPE(world, i) == AK_SHAPE_AABB) {
+      int w = AK_FIXED_TO_INT(AK_BODY_HALF_W(world, i));
+      int h = AK_FIXED_TO_INT(AK_BODY_HALF_H(world, i));
       demo_bitmap_draw_rect(&main_screen, x - w, y - h, w * 2, h * 2,
                             b->is_static ? COL_GREEN : COL_WHITE);
     }
@@ -58,10 +58,14 @@ void RenderWorld(ak_world_t *world) {
 
   for (int i = 0; i < world->tether_count; i++) {
     ak_tether_t *t = &world->tethers[i];
-    int x1 = AK_FIXED_TO_INT(t->a->position.x);
-    int y1 = AK_FIXED_TO_INT(t->a->position.y);
-    int x2 = AK_FIXED_TO_INT(t->b->position.x);
-    int y2 = AK_FIXED_TO_INT(t->b->position.y);
+    int a = ak_world_body_index(world, t->a);
+    int b = ak_world_body_index(world, t->b);
+    if (a < 0 || b < 0)
+      continue;
+    int x1 = AK_FIXED_TO_INT(AK_BODY_POS_X(world, a));
+    int y1 = AK_FIXED_TO_INT(AK_BODY_POS_Y(world, a));
+    int x2 = AK_FIXED_TO_INT(AK_BODY_POS_X(world, b));
+    int y2 = AK_FIXED_TO_INT(AK_BODY_POS_Y(world, b));
     demo_bitmap_draw_line(&main_screen, x1, y1, x2, y2, COL_WHITE);
   }
 }
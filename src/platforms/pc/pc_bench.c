@@ -0,0 +1,578 @@
+#include "ak_physics.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() ((double)__rdtsc())
+#endif
+
+// Headless benchmark. Every scene is rebuilt from a fixed seed at each size,
+// stepped a fixed number of times at 60Hz, and reported as one CSV row:
+//   scene,bodies,steps,ns_per_step,steps_per_s,pair_tests,contacts,
+//   pairs_culled,nodes_culled
+// The last four are averaged per step. Passing a previous run with
+// -b appends baseline_ns_per_step and ratio (current / baseline), so a
+// regression shows up as a ratio above 1.
+//
+// -k instead times the square root and reciprocal kernels of ak_fixed.h, next
+// to the bitwise loops and divides they replaced, and measures their error
+// against double precision:
+//   kernel,calls,ns_per_call,cycles_per_call,max_error_raw,max_error_rel
+// max_error_raw is in 1/65536 units; max_error_rel is for lengths and
+// reciprocals only, as log2 (so -20 means within 2^-20).
+
+#define BENCH_MIN_BODIES 16
+#define BENCH_MAX_SCENES 64
+
+// The world is too big for the stack at benchmark sizes
+static ak_world_t world;
+
+// Deterministic LCG so every platform builds the same scenes
+static uint32_t bench_seed;
+
+static int Random(int lo, int hi) {
+  bench_seed = bench_seed * 1664525u + 1013904223u;
+  return lo + (int)((bench_seed >> 8) % (uint32_t)(hi - lo + 1));
+}
+
+static ak_shape_t Circle(int radius) {
+  ak_shape_t s;
+  s.type = AK_SHAPE_CIRCLE;
+  s.bounds.circle.radius = AK_INT_TO_FIXED(radius);
+  return s;
+}
+
+static ak_shape_t Box(int half_w, int half_h) {
+  ak_shape_t s;
+  s.type = AK_SHAPE_AABB;
+  s.bounds.aabb.width = AK_INT_TO_FIXED(half_w);
+  s.bounds.aabb.height = AK_INT_TO_FIXED(half_h);
+  return s;
+}
+
+// Columns of a roughly square grid holding n cells
+static int GridColumns(int n) {
+  int cols = 1;
+  while (cols * cols < n)
+    cols++;
+  return cols;
+}
+
+// World scaled like the demos (240px reference height) so slop and
+// thresholds match; the container is built from static walls instead.
+static void InitWorld(int gravity) {
+  ak_world_init(&world, AK_INT_TO_FIXED(320), AK_INT_TO_FIXED(240),
+                (ak_vec2_t){0, AK_INT_TO_FIXED(gravity)});
+}
+
+// Closed box with its inside spanning (0,0)-(w,h)
+static void AddContainer(int w, int h) {
+  const int t = 16; // Wall half thickness
+  ak_world_add_body(&world, Box(w / 2 + 2 * t, t), AK_INT_TO_FIXED(w / 2),
+                    AK_INT_TO_FIXED(h + t), 0);
+  ak_world_add_body(&world, Box(w / 2 + 2 * t, t), AK_INT_TO_FIXED(w / 2),
+                    -AK_INT_TO_FIXED(t), 0);
+  ak_world_add_body(&world, Box(t, h / 2 + 2 * t), -AK_INT_TO_FIXED(t),
+                    AK_INT_TO_FIXED(h / 2), 0);
+  ak_world_add_body(&world, Box(t, h / 2 + 2 * t), AK_INT_TO_FIXED(w + t),
+                    AK_INT_TO_FIXED(h / 2), 0);
+}
+
+static void Kick(ak_body_t *b, int speed) {
+  AK_BODY_VEL_X(&world, b->id) = AK_INT_TO_FIXED(Random(-speed, speed));
+  AK_BODY_VEL_Y(&world, b->id) = AK_INT_TO_FIXED(Random(-speed, speed));
+}
+
+// n bodies of one kind spread on a grid with random velocities, no gravity
+static void BuildGas(int n, int kind) {
+  const int spacing = 12;
+  int cols = GridColumns(n);
+  int rows = (n + cols - 1) / cols;
+  InitWorld(0);
+  AddContainer(cols * spacing, rows * spacing);
+  for (int i = 0; i < n; i++) {
+    ak_shape_t s = kind == AK_SHAPE_CIRCLE ? Circle(4) : Box(4, 4);
+    ak_body_t *b = ak_world_add_body(
+        &world, s, AK_INT_TO_FIXED((i % cols) * spacing + spacing / 2),
+        AK_INT_TO_FIXED((i / cols) * spacing + spacing / 2), AK_FIXED_ONE);
+    Kick(b, 40);
+  }
+}
+
+static void BuildCircles(int n) { BuildGas(n, AK_SHAPE_CIRCLE); }
+
+static void BuildBoxes(int n) { BuildGas(n, AK_SHAPE_AABB); }
+
+// Circle gas where all but every eighth body is debris, which collides with
+// the walls and the other bodies but not with itself
+#define LAYER_DEBRIS 0x0002
+
+static void BuildDebris(int n) {
+  BuildGas(n, AK_SHAPE_CIRCLE);
+  for (int d = 0; d < world.dynamic_count; d++) {
+    if (d % 8 != 0)
+      ak_world_set_collision_filter(&world,
+                                    &world.bodies[world.dynamic_bodies[d]],
+                                    LAYER_DEBRIS, AK_LAYER_DEFAULT);
+  }
+}
+
+// Circles and boxes from 2 to 16px falling into a container
+static void BuildMixed(int n) {
+  const int spacing = 34;
+  int cols = GridColumns(n);
+  int rows = (n + cols - 1) / cols;
+  InitWorld(98);
+  AddContainer(cols * spacing, rows * spacing);
+  for (int i = 0; i < n; i++) {
+    int size = Random(2, 16);
+    ak_shape_t s =
+        (i & 1) ? Circle(size) : Box(size, Random(2, 16));
+    ak_body_t *b = ak_world_add_body(
+        &world, s, AK_INT_TO_FIXED((i % cols) * spacing + spacing / 2),
+        AK_INT_TO_FIXED((i / cols) * spacing + spacing / 2),
+        AK_INT_TO_FIXED(size) / 4);
+    Kick(b, 20);
+  }
+}
+
+// Chains of 16 circles (one static anchor, 15 links) hanging side by side
+// and swinging into their neighbours
+static void BuildChains(int n) {
+  const int links = 16, spacing = 10, gap = 16;
+  int chains = (n + links - 1) / links;
+  int cols = GridColumns(chains);
+  int rows = (chains + cols - 1) / cols;
+  int h = rows * links * spacing + spacing;
+  InitWorld(98);
+  AddContainer(cols * gap, h);
+  for (int c = 0; c < chains; c++) {
+    int x = (c % cols) * gap + gap / 2;
+    int y = (c / cols) * links * spacing + spacing / 2;
+    int speed = Random(-60, 60);
+    ak_body_t *prev = ak_world_add_body(
+        &world, Circle(2), AK_INT_TO_FIXED(x), AK_INT_TO_FIXED(y), 0);
+    for (int l = 1; l < links && c * links + l < n; l++) {
+      ak_body_t *b = ak_world_add_body(&world, Circle(3), AK_INT_TO_FIXED(x),
+                                       AK_INT_TO_FIXED(y + l * spacing),
+                                       AK_FIXED_ONE);
+      AK_BODY_VEL_X(&world, b->id) = AK_INT_TO_FIXED(speed * l / links);
+      ak_world_add_tether(&world, prev, b, AK_INT_TO_FIXED(spacing));
+      prev = b;
+    }
+  }
+}
+
+// Touching circles and boxes packed into a container under gravity
+static void BuildPile(int n) {
+  const int spacing = 8;
+  int cols = GridColumns(n);
+  int h = (n + cols - 1) / cols * spacing;
+  InitWorld(98);
+  AddContainer(cols * spacing, h);
+  for (int i = 0; i < n; i++) {
+    int col = i % cols, row = i / cols;
+    ak_shape_t s = ((col + row) & 1) ? Circle(4) : Box(4, 4);
+    ak_world_add_body(&world, s, AK_INT_TO_FIXED(col * spacing + spacing / 2),
+                      AK_INT_TO_FIXED(h - row * spacing - spacing / 2),
+                      AK_FIXED_ONE);
+  }
+}
+
+// Circle gas whose bodies are despawned a quarter at a time every 10 steps
+// and respawned at random as one burst, timing batched adds and removals
+// along with the steps
+#define BURST_INTERVAL 10
+
+static ak_body_handle_t burst_handles[AK_MAX_BODIES];
+static ak_body_def_t burst_defs[AK_MAX_BODIES];
+static int burst_count, burst_next, burst_w, burst_h;
+
+static void BuildBurst(int n) {
+  const int spacing = 12; // As BuildGas lays them out
+  int cols = GridColumns(n);
+  BuildGas(n, AK_SHAPE_CIRCLE);
+  burst_w = cols * spacing;
+  burst_h = (n + cols - 1) / cols * spacing;
+  burst_count = 0;
+  burst_next = 0;
+  for (int d = 0; d < world.dynamic_count; d++) {
+    int i = world.dynamic_bodies[d];
+    burst_handles[burst_count++] = world.bodies[i].handle;
+  }
+}
+
+static void TickBurst(int step) {
+  int n = burst_count / 4;
+  if (step % BURST_INTERVAL != 0 || n == 0)
+    return;
+  ak_body_handle_t *window = &burst_handles[burst_next * n];
+  ak_world_remove_bodies(&world, window, n);
+  for (int k = 0; k < n; k++) {
+    burst_defs[k].shape = Circle(4);
+    burst_defs[k].x = AK_INT_TO_FIXED(Random(4, burst_w - 4));
+    burst_defs[k].y = AK_INT_TO_FIXED(Random(4, burst_h - 4));
+    burst_defs[k].mass = AK_FIXED_ONE;
+  }
+  ak_world_add_bodies(&world, burst_defs, n, window);
+  for (int k = 0; k < n; k++)
+    Kick(ak_world_get_body(&world, window[k]), 40);
+  burst_next = (burst_next + 1) % 4;
+}
+
+typedef struct {
+  const char *name;
+  void (*build)(int n);
+  void (*tick)(int step); // Before each step, if not NULL
+} bench_scene_t;
+
+static const bench_scene_t scenes[] = {
+    {"circles", BuildCircles, NULL}, {"boxes", BuildBoxes, NULL},
+    {"mixed", BuildMixed, NULL},     {"chains", BuildChains, NULL},
+    {"pile", BuildPile, NULL},       {"burst", BuildBurst, TickBurst},
+    {"debris", BuildDebris, NULL},
+};
+
+#define SCENE_COUNT ((int)(sizeof(scenes) / sizeof(scenes[0])))
+
+// Rows read back from a baseline file
+typedef struct {
+  char name[16];
+  int bodies;
+  double ns_per_step;
+} bench_result_t;
+
+static bench_result_t baseline[BENCH_MAX_SCENES];
+static int baseline_count;
+
+static int LoadBaseline(const char *path) {
+  FILE *f = fopen(path, "r");
+  char line[256];
+  if (!f)
+    return 0;
+  while (baseline_count < BENCH_MAX_SCENES && fgets(line, sizeof(line), f)) {
+    bench_result_t *r = &baseline[baseline_count];
+    int steps;
+    // The header and any other line without numbers is skipped
+    if (sscanf(line, "%15[^,],%d,%d,%lf", r->name, &r->bodies, &steps,
+               &r->ns_per_step) == 4)
+      baseline_count++;
+  }
+  fclose(f);
+  return 1;
+}
+
+static const bench_result_t *FindBaseline(const char *name, int bodies) {
+  for (int i = 0; i < baseline_count; i++) {
+    if (baseline[i].bodies == bodies && strcmp(baseline[i].name, name) == 0)
+      return &baseline[i];
+  }
+  return NULL;
+}
+
+static double Now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Small scenes run longer so every row takes a comparable amount of work
+static int DefaultSteps(int n) {
+  int steps = 16384 / n;
+  if (steps < 16)
+    steps = 16;
+  if (steps > 1000)
+    steps = 1000;
+  return steps;
+}
+
+// --- Square root kernels ---
+
+#define KERNEL_INPUTS 4096
+#define KERNEL_REPS 256
+
+// Offsets whose lengths spread evenly over 2^-16..2^12 pixels in log scale,
+// pointing every way
+static ak_vec2_t kernel_in[KERNEL_INPUTS];
+
+static void BuildKernelInputs(void) {
+  bench_seed = 12345u;
+  for (int i = 0; i < KERNEL_INPUTS; i++) {
+    double len = ldexp(1.0 + Random(0, 65535) / 65536.0, Random(0, 27));
+    double angle = Random(0, 65535) * (6.283185307179586 / 65536.0);
+    kernel_in[i].x = (ak_fixed_t)(len * cos(angle));
+    kernel_in[i].y = (ak_fixed_t)(len * sin(angle));
+    if (kernel_in[i].x == 0 && kernel_in[i].y == 0)
+      kernel_in[i].x = 1;
+  }
+}
+
+// Positive 16.16 scalar for the one-argument kernels
+static ak_fixed_t KernelScalar(ak_vec2_t v) {
+  uint32_t x = (uint32_t)(v.x < 0 ? -v.x : v.x) ^ ((uint32_t)v.y << 3);
+  x &= 0x7FFFFFFF;
+  return x ? (ak_fixed_t)(x >> (x & 15)) | 1 : 1;
+}
+
+// The loops these kernels replaced: a 64-bit scan down from 2^62 to the
+// first bit pair, then the root bit by bit
+static uint64_t BitwiseIsqrt(uint64_t rem) {
+  uint64_t root = 0;
+  uint64_t place = 1ULL << 62;
+  while (place > rem)
+    place >>= 2;
+  while (place) {
+    if (rem >= root + place) {
+      rem -= root + place;
+      root += place * 2;
+    }
+    root >>= 1;
+    place >>= 2;
+  }
+  return root;
+}
+
+static void SqrtBitwise(ak_vec2_t v, ak_fixed_t *out) {
+  out[0] = (ak_fixed_t)(BitwiseIsqrt((uint64_t)KernelScalar(v)) << 8);
+}
+
+static void SqrtFast(ak_vec2_t v, ak_fixed_t *out) {
+  out[0] = AK_FIXED_SQRT(KernelScalar(v));
+}
+
+static void LenBitwise(ak_vec2_t v, ak_fixed_t *out) {
+  int64_t x = v.x, y = v.y;
+  out[0] = (ak_fixed_t)BitwiseIsqrt((uint64_t)(x * x + y * y));
+}
+
+static void LenFast(ak_vec2_t v, ak_fixed_t *out) { out[0] = ak_vec2_len(v); }
+
+static void RsqrtDiv(ak_vec2_t v, ak_fixed_t *out) {
+  ak_fixed_t x = KernelScalar(v);
+  out[0] = AK_FIXED_DIV(AK_FIXED_ONE, AK_FIXED_SQRT(x));
+}
+
+static void RsqrtFast(ak_vec2_t v, ak_fixed_t *out) {
+  out[0] = AK_FIXED_RSQRT(KernelScalar(v));
+}
+
+static void NormalizeDiv(ak_vec2_t v, ak_fixed_t *out) {
+  int64_t x = v.x, y = v.y;
+  ak_fixed_t len = (ak_fixed_t)BitwiseIsqrt((uint64_t)(x * x + y * y));
+  ak_vec2_t n = ak_vec2_mul(v, AK_FIXED_DIV(AK_FIXED_ONE, len));
+  out[0] = n.x;
+  out[1] = n.y;
+  out[2] = len;
+}
+
+static void NormalizeFast(ak_vec2_t v, ak_fixed_t *out) {
+  ak_vec2_t n = ak_vec2_normalize(v, &out[2]);
+  out[0] = n.x;
+  out[1] = n.y;
+}
+
+static void RecipDiv(ak_vec2_t v, ak_fixed_t *out) {
+  out[0] = AK_FIXED_DIV(AK_FIXED_ONE, KernelScalar(v));
+}
+
+static void RecipFast(ak_vec2_t v, ak_fixed_t *out) {
+  out[0] = AK_FIXED_RECIP(KernelScalar(v));
+}
+
+typedef enum {
+  KERNEL_SQRT,
+  KERNEL_LEN,
+  KERNEL_RSQRT,
+  KERNEL_NORMALIZE,
+  KERNEL_RECIP
+} kernel_kind_t;
+
+typedef struct {
+  const char *name;
+  void (*run)(ak_vec2_t v, ak_fixed_t *out);
+  kernel_kind_t kind;
+} bench_kernel_t;
+
+static const bench_kernel_t kernels[] = {
+    {"sqrt_bitwise", SqrtBitwise, KERNEL_SQRT},
+    {"AK_FIXED_SQRT", SqrtFast, KERNEL_SQRT},
+    {"len_bitwise", LenBitwise, KERNEL_LEN},
+    {"ak_vec2_len", LenFast, KERNEL_LEN},
+    {"rsqrt_div", RsqrtDiv, KERNEL_RSQRT},
+    {"AK_FIXED_RSQRT", RsqrtFast, KERNEL_RSQRT},
+    {"normalize_div", NormalizeDiv, KERNEL_NORMALIZE},
+    {"ak_vec2_normalize", NormalizeFast, KERNEL_NORMALIZE},
+    {"recip_div", RecipDiv, KERNEL_RECIP},
+    {"AK_FIXED_RECIP", RecipFast, KERNEL_RECIP},
+};
+
+#define KERNEL_COUNT ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+static void Track(double got, double want, int relative, double *max_raw,
+                  double *max_rel) {
+  double err = fabs(got - want);
+  if (relative)
+    *max_rel = fmax(*max_rel, err / want);
+  else
+    *max_raw = fmax(*max_raw, err);
+}
+
+static void RunKernels(void) {
+  static ak_fixed_t out[KERNEL_INPUTS][3];
+
+  BuildKernelInputs();
+  printf("kernel,calls,ns_per_call,cycles_per_call,max_error_raw,"
+         "max_error_rel\n");
+  for (int k = 0; k < KERNEL_COUNT; k++) {
+    const bench_kernel_t *kernel = &kernels[k];
+    long calls = (long)KERNEL_INPUTS * KERNEL_REPS;
+
+    double start = Now();
+#ifdef BENCH_CYCLES
+    double start_cycles = BENCH_CYCLES();
+#endif
+    for (int r = 0; r < KERNEL_REPS; r++) {
+      for (int i = 0; i < KERNEL_INPUTS; i++)
+        kernel->run(kernel_in[i], out[i]);
+    }
+#ifdef BENCH_CYCLES
+    double cycles = (BENCH_CYCLES() - start_cycles) / calls;
+#endif
+    double ns = (Now() - start) / calls;
+
+    double max_raw = 0, max_rel = 0;
+    for (int i = 0; i < KERNEL_INPUTS; i++) {
+      ak_vec2_t v = kernel_in[i];
+      double x = KernelScalar(v);
+      double len = hypot(v.x, v.y);
+      switch (kernel->kind) {
+      case KERNEL_SQRT:
+        Track(out[i][0], sqrt(x * 65536.0), 0, &max_raw, &max_rel);
+        break;
+      case KERNEL_LEN:
+        Track(out[i][0], len, len >= 65536.0, &max_raw, &max_rel);
+        break;
+      case KERNEL_RSQRT:
+        Track(out[i][0], 16777216.0 / sqrt(x), x <= 65536.0, &max_raw,
+              &max_rel);
+        break;
+      case KERNEL_RECIP:
+        if (x > 1.0) // 1/x saturates below that
+          Track(out[i][0], 4294967296.0 / x, x <= 65536.0, &max_raw,
+                &max_rel);
+        break;
+      case KERNEL_NORMALIZE:
+        Track(out[i][0], v.x * 65536.0 / len, 0, &max_raw, &max_rel);
+        Track(out[i][1], v.y * 65536.0 / len, 0, &max_raw, &max_rel);
+        Track(out[i][2], len, len >= 65536.0, &max_raw, &max_rel);
+        break;
+      }
+    }
+
+    printf("%s,%ld,%.2f,", kernel->name, calls, ns);
+#ifdef BENCH_CYCLES
+    printf("%.1f", cycles);
+#endif
+    printf(",%.2f,%.1f\n", max_raw, max_rel > 0 ? log2(max_rel) : -64.0);
+  }
+}
+
+static void Usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-k] [-s steps] [-n max_bodies] [-o scene]"
+          " [-b baseline.csv]"
+#ifdef AK_THREADS
+          " [-t threads]"
+#endif
+          "\n",
+          prog);
+}
+
+int main(int argc, char **argv) {
+  const char *only = NULL, *baseline_path = NULL;
+  int fixed_steps = 0, max_bodies = AK_MAX_BODIES;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "ks:n:o:b:t:")) != -1) {
+    switch (opt) {
+    case 'k':
+      RunKernels();
+      return 0;
+    case 's':
+      fixed_steps = atoi(optarg);
+      break;
+    case 'n':
+      max_bodies = atoi(optarg);
+      break;
+    case 'o':
+      only = optarg;
+      break;
+    case 'b':
+      baseline_path = optarg;
+      break;
+#ifdef AK_THREADS
+    case 't':
+      ak_set_thread_count(atoi(optarg));
+      break;
+#endif
+    default:
+      Usage(argv[0]);
+      return 2;
+    }
+  }
+  if (baseline_path && !LoadBaseline(baseline_path)) {
+    fprintf(stderr, "%s: cannot read %s\n", argv[0], baseline_path);
+    return 1;
+  }
+  // Every scene adds 4 walls to its bodies
+  if (max_bodies > AK_MAX_BODIES - 4)
+    max_bodies = AK_MAX_BODIES - 4;
+
+  ak_fixed_t dt = AK_INT_TO_FIXED(1) / 60;
+  printf("scene,bodies,steps,ns_per_step,steps_per_s,pair_tests,contacts,"
+         "pairs_culled,nodes_culled%s\n",
+         baseline_path ? ",baseline_ns_per_step,ratio" : "");
+  for (int s = 0; s < SCENE_COUNT; s++) {
+    if (only && strcmp(only, scenes[s].name) != 0)
+      continue;
+    for (int n = BENCH_MIN_BODIES; n <= max_bodies; n *= 4) {
+      int steps = fixed_steps > 0 ? fixed_steps : DefaultSteps(n);
+      long pair_tests = 0, contacts = 0, pairs_culled = 0, nodes_culled = 0;
+
+      bench_seed = 12345u;
+      scenes[s].build(n);
+      // Bake outside the timed loop, as a game would after loading a level
+      ak_world_bake_static(&world);
+
+      double start = Now();
+      for (int i = 0; i < steps; i++) {
+        if (scenes[s].tick)
+          scenes[s].tick(i);
+        ak_world_step(&world, dt);
+        pair_tests += world.stats.pair_tests;
+        contacts += world.stats.pair_hits;
+        pairs_culled += world.stats.pairs_culled;
+        nodes_culled += world.stats.nodes_culled;
+      }
+      double ns = (Now() - start) / steps;
+
+      printf("%s,%d,%d,%.0f,%.1f,%ld,%ld,%ld,%ld", scenes[s].name, n, steps,
+             ns, 1e9 / ns, pair_tests / steps, contacts / steps,
+             pairs_culled / steps, nodes_culled / steps);
+      if (baseline_path) {
+        const bench_result_t *b = FindBaseline(scenes[s].name, n);
+        if (b)
+          printf(",%.0f,%.3f", b->ns_per_step, ns / b->ns_per_step);
+        else
+          printf(",,");
+      }
+      printf("\n");
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
@@ -1,11 +1,93 @@
 #include "ak_demo_setup.h"
+#include "ak_events.h"
 #include "ak_physics.h"
+#include "ak_record.h"
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
+#ifdef AK_PROFILE
+// Microseconds from the monotonic clock
+static uint32_t ClockMicros(void *user) {
+  struct timespec ts;
+  (void)user;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)ts.tv_sec * 1000000u + (uint32_t)(ts.tv_nsec / 1000);
+}
+
+static void PrintProfile(const ak_world_t *world) {
+  const uint32_t *t = world->stats.phase_ticks;
+  printf("us: integrate %lu, broadphase %lu, narrowphase %lu, solve %lu, "
+         "sleep %lu | impulses %ld, clamped %ld\n",
+         (unsigned long)t[AK_PHASE_INTEGRATE],
+         (unsigned long)t[AK_PHASE_BROADPHASE],
+         (unsigned long)t[AK_PHASE_NARROWPHASE],
+         (unsigned long)t[AK_PHASE_SOLVE], (unsigned long)t[AK_PHASE_SLEEP],
+         (long)world->stats.impulses, (long)world->stats.clamped);
+}
+#endif
+
+#ifdef AK_EVENTS
+// Contact events, reattached whenever the scene is rebuilt
+static ak_contact_event_t events[256];
+static ak_contact_touch_t touching[2 * 512];
+static ak_event_ring_t event_ring;
+static long begin_count, end_count;
+static char last_event[64];
+
+static void AttachEvents(ak_world_t *world) {
+  ak_event_ring_init(&event_ring, events, 256, touching, 512);
+  event_ring.types = AK_EVENT_BIT(AK_CONTACT_BEGIN) |
+                     AK_EVENT_BIT(AK_CONTACT_END);
+  ak_world_set_event_ring(world, &event_ring);
+}
+
+static const char *ShapeName(const ak_world_t *world, int i) {
+  if (world->bodies[i].is_static)
+    return "Ground";
+  return AK_BODY_SHAPE_TYPE(world, i) == AK_SHAPE_CIRCLE ? "Circle" : "Box";
+}
+
+static void ReadEvents(const ak_world_t *world) {
+  const ak_contact_event_t *e;
+  while ((e = ak_event_ring_next(&event_ring))) {
+    if (e->type == AK_CONTACT_END) {
+      end_count++;
+      continue;
+    }
+    begin_count++;
+    // Name the moving body first
+    int a = e->body_a, b = e->body_b;
+    if (world->bodies[a].is_static) {
+      a = e->body_b;
+      b = e->body_a;
+    }
+    snprintf(last_event, sizeof(last_event), "%s hit %s!",
+             ShapeName(world, a), ShapeName(world, b));
+  }
+}
+#endif
+
+// Session recording (-r): every reset starts the log over with the new scene
+static ak_recorder_t recorder;
+static FILE *record_file;
+
+static void WriteLog(const void *bytes, int32_t size, void *user) {
+  fwrite(bytes, 1, (size_t)size, (FILE *)user);
+}
+
+static void StartRecording(const ak_world_t *world) {
+  if (!record_file)
+    return;
+  rewind(record_file);
+  if (ftruncate(fileno(record_file), 0) != 0)
+    perror("ftruncate");
+  ak_record_begin(&recorder, world, 60, WriteLog, record_file);
+}
+
 // Simple ASCII renderer for PC terminal
 void PrintASCII(ak_world_t *world) {
   char canvas[20][41];
@@ -22,12 +104,12 @@ void PrintASCII(ak_world_t *world) {
     ak_body_t *b = &world->bodies[i];
 
     // Convert world coords to canvas coords (World: 320x240, Canvas: 40x20)
-    int cx = AK_FIXED_TO_INT(b->position.x) / 8;
-    int cy = AK_FIXED_TO_INT(b->position.y) / 12;
+    int cx = AK_FIXED_TO_INT(AK_BODY_POS_X(world, i)) / 8;
+    int cy = AK_FIXED_TO_INT(AK_BODY_POS_Y(world, i)) / 12;
 
-    if (b->shape.type == AK_SHAPE_AABB) {
-      int half_w = AK_FIXED_TO_INT(b->shape.bounds.aabb.width) / 8;
-      int half_h = AK_FIXED_TO_INT(b->shape.bounds.aabb.height) / 12;
+    if (AK_BODY_SHAPE_TYPE(world, i) == AK_SHAPE_AABB) {
+      int half_w = AK_FIXED_TO_INT(AK_BODY_HALF_W(world, i)) / 8;
+      int half_h = AK_FIXED_TO_INT(AK_BODY_HALF_H(world, i)) / 12;
 
       int x1 = cx - half_w;
       int x2 = cx + half_w;
@@ -43,8 +125,8 @@ void PrintASCII(ak_world_t *world) {
           }
         }
       }
-    } else if (b->shape.type == AK_SHAPE_CIRCLE) {
-      int r = AK_FIXED_TO_INT(b->shape.bounds.circle.radius) / 8;
+    } else if (AK_BODY_SHAPE_TYPE(world, i) == AK_SHAPE_CIRCLE) {
+      int r = AK_FIXED_TO_INT(AK_BODY_RADIUS(world, i)) / 8;
       if (r < 1)
         r = 0;
 
@@ -67,12 +149,37 @@ void PrintASCII(ak_world_t *world) {
   }
 }
 
-int main() {
+int main(int argc, char **argv) {
   ak_world_t world;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "r:")) != -1) {
+    if (opt != 'r') {
+      fprintf(stderr, "usage: %s [-r session.aklog]\n", argv[0]);
+      return 2;
+    }
+    record_file = fopen(optarg, "wb");
+    if (!record_file) {
+      perror(optarg);
+      return 1;
+    }
+  }
+
   ak_world_init(
       &world, AK_INT_TO_FIXED(320), AK_INT_TO_FIXED(240),
       (ak_vec2_t){0, 0}); // Initialized with 0 gravity, demo setup will set it
   ak_demo_create_standard_scene(&world);
+#ifdef AK_PROFILE
+  ak_world_set_profile_clock(&world, ClockMicros, NULL);
+#endif
+#ifdef AK_EVENTS
+  AttachEvents(&world);
+#endif
+  StartRecording(&world);
+
+#ifdef AK_THREADS
+  ak_set_thread_count((int)sysconf(_SC_NPROCESSORS_ONLN));
+#endif
 
   // Physics Parity: Standardize on 60Hz internal steps.
   ak_fixed_t dt = AK_INT_TO_FIXED(1) / 60; // 1/60th second
@@ -90,18 +197,68 @@ int main() {
     int ch = getchar();
     if (ch == 'r' || ch == 'R') {
       ak_demo_create_standard_scene(&world);
+#ifdef AK_PROFILE
+      ak_world_set_profile_clock(&world, ClockMicros, NULL);
+#endif
+#ifdef AK_EVENTS
+      AttachEvents(&world);
+#endif
+      StartRecording(&world);
+    } else if (ch == 'k' || ch == 'K') {
+      // Kick every dynamic body upwards
+      for (int k = 0; k < world.dynamic_count; k++) {
+        ak_body_t *b = &world.bodies[world.dynamic_bodies[k]];
+        ak_world_apply_force(
+            &world, b,
+            (ak_vec2_t){0, -AK_FIXED_MUL(AK_BODY_MASS(&world, b->id),
+                                         AK_INT_TO_FIXED(3000))});
+      }
+    } else if ((ch == 'x' || ch == 'X') && world.dynamic_count > 0) {
+      // Remove the newest dynamic body
+      ak_body_handle_t h =
+          world.bodies[world.dynamic_bodies[world.dynamic_count - 1]].handle;
+      if (record_file)
+        ak_record_remove_body(&recorder, &world, h);
+      else
+        ak_world_remove_body(&world, h);
     } else if (ch == 'q' || ch == 'Q') {
       break;
     }
 
-    ak_world_step(&world, dt);
+    if (record_file)
+      ak_record_step(&recorder, &world, dt);
+    else
+      ak_world_step(&world, dt);
     PrintASCII(&world);
-    printf("Alpha Kinetics PC Demo - Bodies: %d, Tethers: %d (R to reset, Q to "
-           "quit)\n",
+    printf("Alpha Kinetics PC Demo - Bodies: %d, Tethers: %d (K to kick, X to "
+           "remove, R to reset, Q to quit)\n",
            world.body_count, world.tether_count);
+    printf("Pairs tested: %ld, Contacts: %ld, Islands: %ld, Asleep: %ld, "
+           "Iterations: %ld\n",
+           (long)world.stats.pair_tests, (long)world.stats.pair_hits,
+           (long)world.stats.islands, (long)world.stats.asleep,
+           (long)world.stats.iterations);
+#ifdef AK_EVENTS
+    ReadEvents(&world);
+    printf("Collision Events: %ld begin, %ld end, %lu dropped. Last: %s\n",
+           begin_count, end_count, (unsigned long)event_ring.overflow,
+           last_event);
+#endif
+#ifdef AK_HASH
+    printf("Frame %ld, Hash %08lx\n", (long)world.frame,
+           (unsigned long)world.hash);
+#endif
+#ifdef AK_PROFILE
+    PrintProfile(&world);
+#endif
     usleep(16666);
   }
 
+  if (record_file) {
+    ak_record_end(&recorder);
+    fclose(record_file);
+  }
+
   // Restore terminal
   tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
   fcntl(STDIN_FILENO, F_SETFL, oldf);
@@ -1,37 +1,71 @@
 #include "ak_demo_setup.h"
 #include "ak_physics.h"
 #include "pd_api.h"
+#include <string.h>
 
 static ak_world_t world;
 static PlaydateAPI *pd = NULL;
 
+#ifdef AK_PROFILE
+// Microseconds since the last resetElapsedTime
+static uint32_t ClockMicros(void *user) {
+  (void)user;
+  return (uint32_t)(pd->system->getElapsedTime() * 1000000.0f);
+}
+
+static void CreateScene(void) {
+  ak_demo_create_standard_scene(&world);
+  ak_world_set_profile_clock(&world, ClockMicros, NULL);
+}
+
+// Phase times of the last step, in microseconds
+static void DrawProfile(void) {
+  const uint32_t *t = world.stats.phase_ticks;
+  char *text = NULL;
+  pd->system->formatString(
+      &text, "int %lu bp %lu np %lu sol %lu slp %lu imp %ld",
+      (unsigned long)t[AK_PHASE_INTEGRATE],
+      (unsigned long)t[AK_PHASE_BROADPHASE],
+      (unsigned long)t[AK_PHASE_NARROWPHASE], (unsigned long)t[AK_PHASE_SOLVE],
+      (unsigned long)t[AK_PHASE_SLEEP], (long)world.stats.impulses);
+  if (text) {
+    pd->graphics->drawText(text, strlen(text), kASCIIEncoding, 2, 2);
+    pd->system->realloc(text, 0);
+  }
+}
+#else
+static void CreateScene(void) { ak_demo_create_standard_scene(&world); }
+#endif
+
 static int update(void *userdata) {
   pd->graphics->clear(kColorWhite);
 
   // Physics Parity: Standardize on 60Hz internal steps.
   // Playdate runs at 30fps, so we take two steps per frame.
   ak_fixed_t dt = AK_INT_TO_FIXED(1) / 60;
+#ifdef AK_PROFILE
+  pd->system->resetElapsedTime();
+#endif
   ak_world_step(&world, dt);
   ak_world_step(&world, dt);
 
   PDButtons pushed;
   pd->system->getButtonState(NULL, &pushed, NULL);
   if (pushed & kButtonA) {
-    ak_demo_create_standard_scene(&world);
+    CreateScene();
   }
 
   for (int i = 0; i < world.body_count; i++) {
-    ak_body_t *b = &world.bodies[i];
-    int x = AK_FIXED_TO_INT(b->position.x);
-    int y = AK_FIXED_TO_INT(b->position.y);
+    int x = AK_FIXED_TO_INT(AK_BODY_POS_X(&world, i));
+    int y = AK_FIXED_TO_INT(AK_BODY_POS_Y(&world, i));
 
-    if (b->shape.type == AK_SHAPE_CIRCLE) {
-      int r = AK_FIXED_TO_INT(b->shape.bounds.circle.radius);
+    if (AK_BODY_SHAPE_TYPE(&world, i) == AK_SHAPE_CIRCLE) {
+      int r = AK_FIXED_TO_INT(AK_BODY_RADIUS(&world, i));
       pd->graphics->drawEllipse(x - r, y - r, r * 2, r * 2, 1, 0, 360,
                                 kColorBlack);
-    } else if (b->shape.type == AK_SHAPE_AABB) {
-      int w = AK_FIXED_TO_INT(b->shape.bounds.aabb.width);
-      int h = AK_FIXED_TO_INT(b->shape.bounds.aabb.height);
+    } else if (AK_BODY_SHAPE_TYPE(&world, i) == AK_SHAPE_AABB) {
+      int w = AK_FIXED_TO_INT(AK_BODY_HALF_W(&world, i));
+      int h = AK_FIXED_TO_INT(AK_BODY_HALF_H(&world, i));
       pd->graphics->drawRect(x - w, y - h, w * 2, h * 2, kColorBlack);
     }
   }
@@ -39,19 +73,25 @@ static int update(void *userdata) {
   // Draw Tethers
   for (int i = 0; i < world.tether_count; i++) {
     ak_tether_t *t = &world.tethers[i];
-    if (t->a == NULL || t->b == NULL)
+    int a = ak_world_body_index(&world, t->a);
+    int b = ak_world_body_index(&world, t->b);
+    if (a < 0 || b < 0)
       continue;
 
-    int x1 = AK_FIXED_TO_INT(t->a->position.x);
-    int y1 = AK_FIXED_TO_INT(t->a->position.y);
-    int x2 = AK_FIXED_TO_INT(t->b->position.x);
-    int y2 = AK_FIXED_TO_INT(t->b->position.y);
+    int x1 = AK_FIXED_TO_INT(AK_BODY_POS_X(&world, a));
+    int y1 = AK_FIXED_TO_INT(AK_BODY_POS_Y(&world, a));
+    int x2 = AK_FIXED_TO_INT(AK_BODY_POS_X(&world, b));
+    int y2 = AK_FIXED_TO_INT(AK_BODY_POS_Y(&world, b));
 
     pd->graphics->drawLine(x1, y1, x2, y2, 1, kColorBlack);
 
     // TODO: Draw curve when tether is slack (current_dist < length)
   }
 
+#ifdef AK_PROFILE
+  DrawProfile();
+#endif
+
   return 1;
 }
 
@@ -60,7 +100,7 @@ int eventHandler(PlaydateAPI *playdate, PDSystemEvent event, uint32_t arg) {
     pd = playdate;
     ak_world_init(&world, AK_INT_TO_FIXED(400), AK_INT_TO_FIXED(240),
                   (ak_vec2_t){0, 0});
-    ak_demo_create_standard_scene(&world);
+    CreateScene();
     pd->system->setUpdateCallback(update, NULL);
   }
   return 0;